@@ -47,25 +47,49 @@ int main(int argc, char *argv[]) {
 Application::Application(char *infile) {
 	int i;
 	par = new Params();
-	srand (time(NULL));
 	par->setparams(infile);
+	seed = time(NULL);
+	transport = NULL;
+	shard = 0;
+	metrics = NULL;
+	load = NULL;
+#ifdef HAVE_CORO_RUNTIME
+	executor = par->CORO_RUNTIME ? new CoroExecutor(par->EN_GPSZ) : NULL;
+#else
+	if( par->CORO_RUNTIME ) {
+		cerr << "CORO_RUNTIME needs a C++20 build, use make coro" << endl;
+		exit(1);
+	}
+#endif
 	log = new Log(par);
 	en = new EmulNet(par);
-	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
+	if( par->EN_TRACE && par->SHARDS > 1 ) {
+		cerr << "EN_TRACE needs SHARDS: 1" << endl;
+		exit(1);
+	}
+	// a replayed run starts from the recorded seed, so failures and random choices repeat
+	if( par->EN_TRACE == EN_TRACE_REPLAY && !en->ENreplay(EN_TRACE_FILE, &seed) ) {
+		cerr << "Cannot replay " << EN_TRACE_FILE << endl;
+		exit(1);
+	}
+	if( par->EN_TRACE == EN_TRACE_RECORD && !en->ENrecord(EN_TRACE_FILE, seed) ) {
+		cerr << "Cannot record " << EN_TRACE_FILE << endl;
+		exit(1);
+	}
+	srand(seed);
+	failSeed = rand();
+	mp1 = (MP1Node **) calloc(par->EN_GPSZ, sizeof(MP1Node *));
+	members = (Member **) malloc(par->EN_GPSZ * sizeof(Member *));
 
 	/*
-	 * Init all nodes
+	 * Give all nodes their address, the nodes themselves are built by initNodes
 	 */
 	for( i = 0; i < par->EN_GPSZ; i++ ) {
 		Member *memberNode = new Member;
 		memberNode->inited = false;
-		Address *addressOfMemberNode = new Address();
-		Address joinaddr;
-		joinaddr = getjoinaddr();
-		addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
-		mp1[i] = new MP1Node(memberNode, par, en, log, addressOfMemberNode);
-		log->LOG(&(mp1[i]->getMemberNode()->addr), "APP");
-		delete addressOfMemberNode;
+		en->ENinit(&memberNode->addr, par->PORTNUM);
+		members[i] = memberNode;
+		log->LOG(&memberNode->addr, "APP");
 	}
 }
 
@@ -77,9 +101,17 @@ Application::~Application() {
 	delete en;
 	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
 		delete mp1[i];
+		delete members[i];
 	}
 	free(mp1);
+	free(members);
 	delete par;
+	delete transport;
+	delete metrics;
+	delete load;
+#ifdef HAVE_CORO_RUNTIME
+	delete executor;
+#endif
 }
 
 /**
@@ -93,26 +125,154 @@ int Application::run()
 	int timeWhenAllNodesHaveJoined = 0;
 	// boolean indicating if all nodes have joined
 	bool allNodesJoined = false;
-	srand(time(NULL));
+	srand(seed);
+
+	if( par->SHARDS > 1 ) {
+		startShards();
+	}
+	initNodes();
+
+	if( par->METRICS ) {
+		metrics = new Metrics(par, par->EN_GPSZ);
+		for( i = 0; i < par->EN_GPSZ; i++ ) {
+			if( ownsNode(i) ) {
+				metrics->watch(i + 1);
+				mp1[i]->addListener(metrics);
+			}
+		}
+	}
+
+	if( par->APP_RATE > 0 ) {
+		load = new LoadGenerator(par, en, members, shard);
+	}
 
 	// As time runs along
 	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
 		// Run the membership protocol
 		mp1Run();
+		// Application traffic shares the network with it
+		if( load != NULL ) {
+			for( i = 0; i < par->EN_GPSZ; i++ ) {
+				if( ownsNode(i) && par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp1[i]->getMemberNode()->bFailed ) {
+					load->generate(i);
+				}
+			}
+		}
 		// Fail some nodes
 		fail();
+		if( metrics != NULL ) {
+			metrics->tick();
+		}
+		// Wait for the other shards to finish this tick, then collect their messages
+		if( transport != NULL ) {
+			transport->barrier();
+			en->ENsync();
+		}
+		if( par->MEM_REPORT_INTERVAL > 0 && par->globaltime % par->MEM_REPORT_INTERVAL == 0 ) {
+			reportMemory(false);
+		}
+	}
+
+	reportMemory(true);
+	for( i = 0; i < par->EN_GPSZ; i++ ) {
+		if( ownsNode(i) ) {
+			mp1[i]->logSweepStats();
+		}
+	}
+
+	if( metrics != NULL ) {
+		char filename[40];
+		if( transport != NULL && shard > 0 ) {
+			sprintf(filename, "metrics.%d.json", shard);
+		}
+		else {
+			strcpy(filename, "metrics.json");
+		}
+		long appMessages = 0, appBytes = 0;
+		if( load != NULL ) {
+			appMessages = load->getSent();
+			appBytes = load->getSentBytes();
+			metrics->appTraffic(appMessages, appBytes, load->getLost(), load->getRefused());
+		}
+		metrics->writeReport(filename, en->getSentMessages() - appMessages, en->getSentBytes() - appBytes);
+	}
+
+	for(i=0;i<=par->EN_GPSZ-1;i++) {
+		if( ownsNode(i) ) {
+			mp1[i]->finishUpThisNode();
+		}
 	}
 
 	// Clean up
 	en->ENcleanup();
 
-	for(i=0;i<=par->EN_GPSZ-1;i++) {
-		 mp1[i]->finishUpThisNode();
+#ifdef HAVE_CORO_RUNTIME
+	if( executor != NULL ) {
+		cout << "coroutine resumes: " << executor->getResumes() << endl;
+	}
+#endif
+
+	if( transport != NULL && shard == 0 ) {
+		while( wait(NULL) > 0 );
+		cout << "cross-shard messages dropped on full rings: " << transport->getDropped() << endl;
 	}
 
 	return SUCCESS;
 }
 
+/**
+ * FUNCTION NAME: initNodes
+ *
+ * DESCRIPTION: Build the nodes this process runs. The others of a sharded
+ * 				run stay a Member stub that only holds their address and
+ * 				whether they have failed.
+ */
+void Application::initNodes() {
+	for( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if( ownsNode(i) ) {
+			Address addressOfMemberNode = members[i]->addr;
+			mp1[i] = MP1Node::create(members[i], par, en, log, &addressOfMemberNode);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: startShards
+ *
+ * DESCRIPTION: Fork SHARDS - 1 worker processes, before the nodes are built.
+ * 				Every process only builds and runs the nodes of its own slice;
+ * 				messages between slices travel over the shared-memory transport.
+ */
+void Application::startShards() {
+	transport = new ShmTransport(par->SHARDS, par->SHARD_RING_BYTES);
+	// Anything still buffered would otherwise be written once per process
+	cout.flush();
+	fflush(NULL);
+
+	for( int k = 1; k < par->SHARDS; k++ ) {
+		pid_t pid = fork();
+		if( pid < 0 ) {
+			perror("fork");
+			exit(1);
+		}
+		if( pid == 0 ) {
+			shard = k;
+			break;
+		}
+	}
+	srand(time(NULL) ^ (shard << 16));
+	en->ENshard(transport, shard, par->SHARDS);
+}
+
+/**
+ * FUNCTION NAME: ownsNode
+ *
+ * DESCRIPTION: Check if the ith node runs in this process
+ */
+bool Application::ownsNode(int i) {
+	return transport == NULL || en->shardOf(i + 1) == shard;
+}
+
 /**
  * FUNCTION NAME: mp1Run
  *
@@ -127,9 +287,18 @@ void Application::mp1Run() {
 		/*
 		 * Receive messages from the network and queue them in the membership protocol queue
 		 */
+		if( !ownsNode(i) ) {
+			continue;
+		}
+
 		if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
 			// Receive messages from the network and queue them
 			mp1[i]->recvLoop();
+			#ifdef HAVE_CORO_RUNTIME
+			if( executor != NULL && !mp1[i]->getMemberNode()->mp1q.empty() ) {
+				executor->notifyMessage(i);
+			}
+			#endif
 		}
 
 	}
@@ -137,6 +306,10 @@ void Application::mp1Run() {
 	// For all the nodes in the system
 	for( i = par->EN_GPSZ - 1; i >= 0; i-- ) {
 
+		if( !ownsNode(i) ) {
+			continue;
+		}
+
 		/*
 		 * Introduce nodes into the distributed system
 		 */
@@ -145,12 +318,17 @@ void Application::mp1Run() {
 			mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
 			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
 			nodeCount += i;
+			#ifdef HAVE_CORO_RUNTIME
+			if( executor != NULL ) {
+				executor->spawn(i, mp1[i]->protocol(executor, i), par->getcurrtime() + 1);
+			}
+			#endif
 		}
 
 		/*
 		 * Handle all the messages in your queue and send heartbeats
 		 */
-		else if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
+		else if( !par->CORO_RUNTIME && par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
 			// handle messages and send heartbeats
 			mp1[i]->nodeLoop();
 			#ifdef DEBUGLOG
@@ -161,6 +339,13 @@ void Application::mp1Run() {
 		}
 
 	}
+
+	#ifdef HAVE_CORO_RUNTIME
+	// Resume the nodes that have a message or a due protocol period
+	if( executor != NULL ) {
+		executor->runTick(par->getcurrtime());
+	}
+	#endif
 }
 
 /**
@@ -179,19 +364,35 @@ void Application::fail() {
 	}
 
 	if( par->SINGLE_FAILURE && par->getcurrtime() == 100 ) {
-		removed = (rand() % par->EN_GPSZ);
+		removed = (rand_r(&failSeed) % par->EN_GPSZ);
 		#ifdef DEBUGLOG
-		log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
+		if( ownsNode(removed) ) {
+			log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
+		}
 		#endif
-		mp1[removed]->getMemberNode()->bFailed = true;
+		if( par->GRACEFUL_LEAVE && ownsNode(removed) ) {
+			mp1[removed]->leaveGroup();
+		}
+		members[removed]->bFailed = true;
+		if( metrics != NULL ) {
+			metrics->nodeFailed(removed + 1);
+		}
 	}
 	else if( par->getcurrtime() == 100 ) {
-		removed = rand() % par->EN_GPSZ/2;
+		removed = rand_r(&failSeed) % par->EN_GPSZ/2;
 		for ( i = removed; i < removed + par->EN_GPSZ/2; i++ ) {
 			#ifdef DEBUGLOG
-			log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime());
+			if( ownsNode(i) ) {
+				log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime());
+			}
 			#endif
-			mp1[i]->getMemberNode()->bFailed = true;
+			if( par->GRACEFUL_LEAVE && ownsNode(i) ) {
+				mp1[i]->leaveGroup();
+			}
+			members[i]->bFailed = true;
+			if( metrics != NULL ) {
+				metrics->nodeFailed(i + 1);
+			}
 		}
 	}
 
@@ -201,6 +402,31 @@ void Application::fail() {
 
 }
 
+/**
+ * FUNCTION NAME: reportMemory
+ *
+ * DESCRIPTION: Write the memory held by all nodes and by EmulNet to the stats log,
+ * 				optionally with every node's own breakdown
+ */
+void Application::reportMemory(bool perNode) {
+	long nodesTotal = 0;
+	long nodeMax = 0;
+	for( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if( !ownsNode(i) ) {
+			continue;
+		}
+		long bytes = mp1[i]->memoryUsage();
+		nodesTotal += bytes;
+		nodeMax = max(nodeMax, bytes);
+		if( perNode ) {
+			mp1[i]->logMemoryUsage();
+		}
+	}
+	log->LOG(&members[0]->addr, "#STATSLOG# mem nodes=%ld max_node=%ld emulnet=%ld en_buffered=%ld en_shed=%ld en_backpressured=%ld directory=%ld total=%ld",
+		nodesTotal, nodeMax, en->memoryUsage(), en->getBufferedBytes(), en->getShedMessages(), en->getBackpressured(),
+		PeerDirectory::memoryUsage(), nodesTotal + en->memoryUsage() + PeerDirectory::memoryUsage());
+}
+
 /**
  * FUNCTION NAME: getjoinaddr
  *
@@ -208,10 +434,7 @@ void Application::fail() {
  */
 Address Application::getjoinaddr(void){
 	//trace.funcEntry("Application::getjoinaddr");
-    Address joinaddr;
-    joinaddr.init();
-    *(int *)(&(joinaddr.addr))=1;
-    *(short *)(&(joinaddr.addr[4]))=0;
+    Address joinaddr = NodeId(1, 0).toAddress();
     //trace.funcExit("Application::getjoinaddr", SUCCESS);
     return joinaddr;
 }
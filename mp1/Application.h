@@ -14,6 +14,10 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "ShmTransport.h"
+#include "Metrics.h"
+#include "LoadGenerator.h"
+#include <sys/wait.h>
 
 /**
  * global variables
@@ -38,8 +42,29 @@ private:
 	char JOINADDR[30];
 	EmulNet *en;
     Log *log;
+	// nodes this process runs, NULL for those of other shards
 	MP1Node **mp1;
+	// every node's Member, a stub for the nodes of other shards
+	Member **members;
 	Params *par;
+	// Shard processes share this transport, NULL when running in one process
+	ShmTransport *transport;
+	int shard;
+	// Seed of the run, the recorded one when replaying EN_TRACE
+	unsigned int seed;
+	// Failure choices must agree across shards, so they use their own seed
+	unsigned int failSeed;
+#ifdef HAVE_CORO_RUNTIME
+	// Schedules node coroutines when CORO_RUNTIME is set
+	CoroExecutor *executor;
+#endif
+	// Ground truth and what the nodes know, NULL when METRICS is 0
+	Metrics *metrics;
+	// Application traffic between members, NULL unless APP_RATE is set
+	LoadGenerator *load;
+	bool ownsNode(int i);
+	void initNodes();
+	void startShards();
 public:
 	Application(char *);
 	virtual ~Application();
@@ -47,6 +72,7 @@ public:
 	int run();
 	void mp1Run();
 	void fail();
+	void reportMemory(bool perNode);
 };
 
 #endif /* _APPLICATION_H__ */
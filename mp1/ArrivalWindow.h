@@ -0,0 +1,65 @@
+/**********************************
+ * FILE NAME: ArrivalWindow.h
+ *
+ * DESCRIPTION: Heartbeat inter-arrival statistics of a single member,
+ * 				used by the phi-accrual failure detector
+ **********************************/
+
+#ifndef ARRIVALWINDOW_H_
+#define ARRIVALWINDOW_H_
+
+#include "stdincludes.h"
+
+/**
+ * Macros
+ */
+// number of inter-arrival times kept per member
+#define PHI_WINDOW 8
+// interval assumed until a member's first inter-arrival time is seen
+#define PHI_PRIOR_INTERVAL 2.0
+
+/**
+ * CLASS NAME: ArrivalWindow
+ *
+ * DESCRIPTION: Fixed ring of the last PHI_WINDOW heartbeat inter-arrival times
+ */
+class ArrivalWindow {
+public:
+	int intervals[PHI_WINDOW];
+	int count;
+	int next;
+	long last;
+	ArrivalWindow(): count(0), next(0), last(-1) {}
+	/**
+	 * Note a newer heartbeat seen at time now. Several in one tick count once.
+	 */
+	void record(long now) {
+		if ( last >= 0 && now > last ) {
+			intervals[next] = (int)(now - last);
+			next = (next + 1) % PHI_WINDOW;
+			if ( count < PHI_WINDOW ) {
+				count++;
+			}
+		}
+		last = now;
+	}
+	double mean() {
+		if ( count == 0 ) {
+			return PHI_PRIOR_INTERVAL;
+		}
+		long sum = 0;
+		for ( int i = 0; i < count; i++ ) {
+			sum += intervals[i];
+		}
+		return max(1.0, (double)sum / count);
+	}
+	/**
+	 * Suspicion level at time now, assuming exponentially distributed
+	 * inter-arrival times: phi = -log10(P(no heartbeat for this long))
+	 */
+	double phi(long now) {
+		return (now - last) / mean() * M_LOG10E;
+	}
+};
+
+#endif /* ARRIVALWINDOW_H_ */
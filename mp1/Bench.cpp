@@ -0,0 +1,306 @@
+/**********************************
+ * FILE NAME: Bench.cpp
+ *
+ * DESCRIPTION: Microbenchmarks for the membership protocol hot paths.
+ * 				Built by "make bench", run as ./Bench [testcase.conf]
+ **********************************/
+
+#include "stdincludes.h"
+#include "MP1Node.h"
+#include "EmulNet.h"
+#include "Log.h"
+#include "Params.h"
+#include "Member.h"
+
+/*
+ * Macros
+ */
+#define BENCH_MIN_NS 200000000L
+#define BENCH_MERGE_ENTRIES 100
+#define BENCH_PAYLOAD 100
+#define BENCH_TIME 10
+
+/**
+ * Allocation counters, fed by the malloc family below. operator new
+ * ends up in malloc, so C++ allocations are counted too.
+ */
+static long allocCount = 0;
+static long allocBytes = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+	allocCount++;
+	allocBytes += size;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+	allocCount++;
+	allocBytes += n * size;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	allocCount++;
+	allocBytes += size;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+	__libc_free(ptr);
+}
+}
+
+/**
+ * STRUCT NAME: BenchEnv
+ *
+ * DESCRIPTION: A node with a synthetic member list and the network it sends on
+ */
+typedef struct BenchEnv {
+	Params *par;
+	EmulNet *en;
+	Log *log;
+	Member *member;
+	FlatTimeoutNode *node;
+	Address target;
+}BenchEnv;
+
+/**
+ * FUNCTION NAME: nowNs
+ *
+ * DESCRIPTION: Monotonic clock in nanoseconds
+ */
+static long nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: discardMessage
+ *
+ * DESCRIPTION: ENrecv callback that drops what it receives
+ */
+static int discardMessage(void *env, char *buff, int size) {
+	free(buff);
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Empty the EmulNet buffer held for the target
+ */
+static void drain(BenchEnv &env) {
+	env.en->ENrecv(&env.target, discardMessage, NULL, 1, NULL);
+}
+
+/**
+ * FUNCTION NAME: setupEnv
+ *
+ * DESCRIPTION: Node 1 in the group with members 2..size+1, all fresh
+ */
+static void setupEnv(BenchEnv &env, char *conf, int size) {
+	env.par = new Params();
+	env.par->setparams(conf);
+	env.par->globaltime = BENCH_TIME;
+	env.par->dropmsg = 0;
+	// let serialization of large lists reach the network
+	env.par->MAX_MSG_SIZE = 1 << 30;
+	env.en = new EmulNet(env.par);
+	env.log = new Log(env.par);
+	env.member = new Member;
+	Address self;
+	env.en->ENinit(&self, env.par->PORTNUM);
+	env.node = new FlatTimeoutNode(env.member, env.par, env.en, env.log, &self);
+	env.node->initThisNode(&self);
+	env.member->inGroup = true;
+	for ( int i = 0; i < size; i++ ) {
+		env.member->memberList.push_back(MemberListEntry(i + 2, 0, 1, BENCH_TIME));
+	}
+	env.target = env.node->buildAddress(2, 0);
+}
+
+/**
+ * FUNCTION NAME: teardownEnv
+ */
+static void teardownEnv(BenchEnv &env) {
+	drain(env);
+	delete env.node;
+	delete env.member;
+	delete env.log;
+	delete env.en;
+	delete env.par;
+}
+
+/**
+ * FUNCTION NAME: report
+ *
+ * DESCRIPTION: Print one result row
+ */
+static void report(const char *name, int size, long ops, long ns, long allocs, long bytes) {
+	printf("%-22s %8d %14.1f %12.2f %14.1f\n", name, size, (double) ns / ops, (double) allocs / ops, (double) bytes / ops);
+}
+
+/**
+ * FUNCTION NAME: measure
+ *
+ * DESCRIPTION: Run batches of ops until BENCH_MIN_NS of timed work. batch runs
+ * 				opsPerBatch operations and is timed; reset restores the
+ * 				starting state between batches and is not.
+ */
+template <typename Batch, typename Reset>
+static void measure(const char *name, int size, int opsPerBatch, Batch batch, Reset reset) {
+	long ops = 0, ns = 0, allocs = 0, bytes = 0;
+	streambuf *out = cout.rdbuf(NULL);
+	while ( ns < BENCH_MIN_NS ) {
+		long count0 = allocCount, bytes0 = allocBytes;
+		long start = nowNs();
+		batch();
+		ns += nowNs() - start;
+		allocs += allocCount - count0;
+		bytes += allocBytes - bytes0;
+		ops += opsPerBatch;
+		reset();
+	}
+	cout.rdbuf(out);
+	report(name, size, ops, ns, allocs, bytes);
+}
+
+/**
+ * FUNCTION NAME: heartbeatMessage
+ *
+ * DESCRIPTION: HEARTBEATREQ body (after the header) carrying entries spread over the member list
+ */
+static vector<char> heartbeatMessage(BenchEnv &env, int entries, long heartbeat) {
+	vector<MemberListEntry> &list = env.member->memberList;
+	int count = min(entries, (int) list.size());
+	vector<char> data(sizeof(Address) + sizeof(int) + count * (sizeof(Address) + sizeof(long)));
+	int offset = 0;
+	memcpy(&data[offset], &env.target.addr, sizeof(Address));
+	offset += sizeof(Address);
+	memcpy(&data[offset], &count, sizeof(int));
+	offset += sizeof(int);
+	for ( int i = 0; i < count; i++ ) {
+		MemberListEntry &entry = list[(long) i * list.size() / count];
+		entry.getnode().copyTo(&data[offset]);
+		offset += sizeof(Address);
+		memcpy(&data[offset], &heartbeat, sizeof(long));
+		offset += sizeof(long);
+	}
+	return data;
+}
+
+/**
+ * FUNCTION NAME: benchMembers
+ *
+ * DESCRIPTION: Member list functions against a list of the given size
+ */
+static void benchMembers(char *conf, int size) {
+	BenchEnv env;
+	setupEnv(env, conf, size);
+	vector<MemberListEntry> &list = env.member->memberList;
+
+	// Steady state gossip: the message repeats heartbeats we already hold
+	vector<char> merge = heartbeatMessage(env, BENCH_MERGE_ENTRIES, 1);
+	measure("mergeMemberlist", size, 1, [&]() {
+		env.node->mergeMemberlist(env.member, merge.data(), merge.size());
+	}, []() {});
+
+	int sends = max(1, min(1000, 100000 / size));
+	measure("sendWithMemberList", size, sends, [&]() {
+		for ( int i = 0; i < sends; i++ ) {
+			env.node->sendWithMemberList(HEARTBEATREQ, &env.target);
+		}
+	}, [&]() { drain(env); });
+
+	long heartbeat = 1;
+	int next = 0;
+	measure("updateMemberList", size, 1000, [&]() {
+		heartbeat++;
+		for ( int i = 0; i < 1000; i++ ) {
+			env.node->updateMemberList(list[next].getnode(), heartbeat);
+			next = (next + 7919) % list.size();
+		}
+	}, []() {});
+
+	measure("cleanupMembers", size, 1, [&]() {
+		env.node->cleanupMembers();
+	}, []() {});
+
+	// the sweep paces itself by ticks, so every call is a new tick with fresh members
+	env.par->INCREMENTAL_SWEEP = 1;
+	measure("cleanupMembers/sweep", size, 1, [&]() {
+		env.node->cleanupMembers();
+	}, [&]() {
+		env.par->globaltime++;
+		for ( auto &entry : list ) {
+			entry.settimestamp(env.par->globaltime);
+		}
+	});
+	env.par->INCREMENTAL_SWEEP = 0;
+	env.par->globaltime = BENCH_TIME;
+
+	teardownEnv(env);
+}
+
+/**
+ * FUNCTION NAME: benchNetwork
+ *
+ * DESCRIPTION: EmulNet send and receive, and debug logging
+ */
+static void benchNetwork(char *conf) {
+	BenchEnv env;
+	setupEnv(env, conf, 1);
+	char payload[BENCH_PAYLOAD];
+	memset(payload, 0, sizeof(payload));
+	Address self = env.member->addr;
+
+	measure("ENsend", BENCH_PAYLOAD, 1000, [&]() {
+		for ( int i = 0; i < 1000; i++ ) {
+			env.en->ENsend(&self, &env.target, payload, sizeof(payload));
+		}
+	}, [&]() { drain(env); });
+
+	// one ENrecv call picks up all 1000 buffered messages
+	for ( int i = 0; i < 1000; i++ ) {
+		env.en->ENsend(&self, &env.target, payload, sizeof(payload));
+	}
+	measure("ENrecv", BENCH_PAYLOAD, 1000, [&]() {
+		drain(env);
+	}, [&]() {
+		for ( int i = 0; i < 1000; i++ ) {
+			env.en->ENsend(&self, &env.target, payload, sizeof(payload));
+		}
+	});
+
+	measure("Log::LOG", 1, 1000, [&]() {
+		for ( int i = 0; i < 1000; i++ ) {
+			env.log->LOG(&self, "bench line %d", i);
+		}
+	}, []() {});
+
+	teardownEnv(env);
+}
+
+/**
+ * FUNCTION NAME: main
+ */
+int main(int argc, char *argv[]) {
+	char defaultConf[] = "testcases/singlefailure.conf";
+	char *conf = argc > 1 ? argv[1] : defaultConf;
+	int sizes[] = { 10, 100, 1000, 10000, 100000 };
+
+	printf("%-22s %8s %14s %12s %14s\n", "benchmark", "size", "ns/op", "allocs/op", "bytes/op");
+	for ( int size : sizes ) {
+		benchMembers(conf, size);
+	}
+	benchNetwork(conf);
+
+	return SUCCESS;
+}
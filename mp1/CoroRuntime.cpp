@@ -0,0 +1,142 @@
+/**********************************
+ * FILE NAME: CoroRuntime.cpp
+ *
+ * DESCRIPTION: Optional coroutine runtime for node protocols
+ **********************************/
+
+#include "CoroRuntime.h"
+
+#ifdef HAVE_CORO_RUNTIME
+
+/**
+ * FUNCTION NAME: await_suspend
+ *
+ * DESCRIPTION: Park the node until a message or its deadline
+ */
+void MessageAwaiter::await_suspend(coroutine_handle<> h) {
+	executor->wait(slot, h, deadline);
+}
+
+/**
+ * FUNCTION NAME: await_resume
+ *
+ * DESCRIPTION: Tell the node why it was resumed
+ */
+bool MessageAwaiter::await_resume() {
+	return executor->wokenByMessage(slot);
+}
+
+/**
+ * Constructor
+ */
+CoroExecutor::CoroExecutor(int nodes): tasks(nodes), waits(nodes), resumes(0) {
+	for ( auto &w : waits ) {
+		w.handle = nullptr;
+		w.deadline = 0;
+		w.waiting = false;
+		w.byMessage = false;
+	}
+}
+
+/**
+ * FUNCTION NAME: spawn
+ *
+ * DESCRIPTION: Take ownership of a node's coroutine and first resume it at tick start
+ */
+void CoroExecutor::spawn(int slot, NodeTask task, int start) {
+	tasks[slot] = move(task);
+	wait(slot, tasks[slot].handle, start);
+}
+
+/**
+ * FUNCTION NAME: wait
+ *
+ * DESCRIPTION: Record a suspended node and arm its deadline
+ */
+void CoroExecutor::wait(int slot, coroutine_handle<> h, int deadline) {
+	CoroWait &w = waits[slot];
+	w.handle = h;
+	w.deadline = deadline;
+	w.waiting = true;
+	timers.push(make_pair(deadline, slot));
+}
+
+/**
+ * FUNCTION NAME: notifyMessage
+ *
+ * DESCRIPTION: Schedule a node that has a message waiting in its inbox
+ */
+void CoroExecutor::notifyMessage(int slot) {
+	CoroWait &w = waits[slot];
+	if ( !w.waiting ) {
+		return;
+	}
+	w.waiting = false;
+	w.byMessage = true;
+	ready.push_back(slot);
+}
+
+/**
+ * FUNCTION NAME: runTick
+ *
+ * DESCRIPTION: Resume every node whose deadline is due or that was notified.
+ * 				Nodes that finish are destroyed.
+ */
+void CoroExecutor::runTick(int now) {
+	while ( !timers.empty() && timers.top().first <= now ) {
+		int deadline = timers.top().first;
+		int slot = timers.top().second;
+		timers.pop();
+		CoroWait &w = waits[slot];
+		if ( w.waiting && w.deadline == deadline ) {
+			w.waiting = false;
+			w.byMessage = false;
+			ready.push_back(slot);
+		}
+	}
+
+	for ( size_t i = 0; i < ready.size(); i++ ) {
+		int slot = ready[i];
+		coroutine_handle<> h = waits[slot].handle;
+		resumes++;
+		h.resume();
+		if ( h.done() ) {
+			waits[slot].waiting = false;
+			tasks[slot] = NodeTask();
+		}
+	}
+	ready.clear();
+}
+
+/**
+ * FUNCTION NAME: wokenByMessage
+ *
+ * DESCRIPTION: Check if a node was last resumed by a message
+ */
+bool CoroExecutor::wokenByMessage(int slot) {
+	return waits[slot].byMessage;
+}
+
+/**
+ * FUNCTION NAME: message
+ *
+ * DESCRIPTION: Awaitable that suspends a node until a message arrives or the deadline tick
+ */
+MessageAwaiter CoroExecutor::message(int slot, int deadline) {
+	MessageAwaiter awaiter;
+	awaiter.executor = this;
+	awaiter.slot = slot;
+	awaiter.deadline = deadline;
+	return awaiter;
+}
+
+/**
+ * FUNCTION NAME: getResumes
+ *
+ * DESCRIPTION: Number of coroutine resumptions so far
+ */
+long CoroExecutor::getResumes() {
+	return resumes;
+}
+
+#endif /* HAVE_CORO_RUNTIME */
@@ -0,0 +1,119 @@
+/**********************************
+ * FILE NAME: CoroRuntime.h
+ *
+ * DESCRIPTION: Optional coroutine runtime for node protocols.
+ * 				Only available when built with -std=c++20 (make coro).
+ **********************************/
+
+#ifndef _CORORUNTIME_H_
+#define _CORORUNTIME_H_
+
+#include "stdincludes.h"
+
+#if __cplusplus >= 202002L
+#define HAVE_CORO_RUNTIME 1
+#include <coroutine>
+
+class CoroExecutor;
+
+/**
+ * CLASS NAME: NodeTask
+ *
+ * DESCRIPTION: Owning handle to a node's protocol coroutine. The coroutine
+ * 				starts suspended and is only ever resumed by a CoroExecutor.
+ */
+class NodeTask {
+public:
+	struct promise_type {
+		NodeTask get_return_object() {
+			return NodeTask(coroutine_handle<promise_type>::from_promise(*this));
+		}
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { terminate(); }
+	};
+	coroutine_handle<promise_type> handle;
+	NodeTask(): handle(nullptr) {}
+	explicit NodeTask(coroutine_handle<promise_type> h): handle(h) {}
+	NodeTask(NodeTask &&anotherTask): handle(anotherTask.handle) {
+		anotherTask.handle = nullptr;
+	}
+	NodeTask& operator =(NodeTask &&anotherTask) {
+		if ( handle ) {
+			handle.destroy();
+		}
+		handle = anotherTask.handle;
+		anotherTask.handle = nullptr;
+		return *this;
+	}
+	NodeTask(const NodeTask &) = delete;
+	NodeTask& operator =(const NodeTask &) = delete;
+	virtual ~NodeTask() {
+		if ( handle ) {
+			handle.destroy();
+		}
+	}
+};
+
+/**
+ * STRUCT NAME: CoroWait
+ *
+ * DESCRIPTION: What a suspended node is waiting for
+ */
+typedef struct CoroWait {
+	coroutine_handle<> handle;
+	// Tick at which the node is resumed even without a message
+	int deadline;
+	// The node is suspended and not yet scheduled
+	bool waiting;
+	// Why the node was last resumed
+	bool byMessage;
+}CoroWait;
+
+/**
+ * CLASS NAME: MessageAwaiter
+ *
+ * DESCRIPTION: co_await result is true if a message woke the node,
+ * 				false if its deadline passed
+ */
+class MessageAwaiter {
+public:
+	CoroExecutor *executor;
+	int slot;
+	int deadline;
+	bool await_ready() { return false; }
+	void await_suspend(coroutine_handle<> h);
+	bool await_resume();
+};
+
+/**
+ * CLASS NAME: CoroExecutor
+ *
+ * DESCRIPTION: Single-threaded scheduler for node coroutines. A tick only
+ * 				resumes nodes that were notified of a message or whose
+ * 				deadline is due; every other node costs nothing.
+ */
+class CoroExecutor {
+private:
+	vector<NodeTask> tasks;
+	vector<CoroWait> waits;
+	vector<int> ready;
+	// (deadline, slot); entries made stale by an earlier wakeup are skipped
+	priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > timers;
+	long resumes;
+public:
+	CoroExecutor(int nodes);
+	virtual ~CoroExecutor() {}
+	void spawn(int slot, NodeTask task, int start);
+	void wait(int slot, coroutine_handle<> h, int deadline);
+	void notifyMessage(int slot);
+	void runTick(int now);
+	bool wokenByMessage(int slot);
+	MessageAwaiter message(int slot, int deadline);
+	long getResumes();
+};
+
+#endif /* __cplusplus >= 202002L */
+
+#endif /* _CORORUNTIME_H_ */
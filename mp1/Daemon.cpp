@@ -0,0 +1,239 @@
+/**********************************
+ * FILE NAME: Daemon.cpp
+ *
+ * DESCRIPTION: Standalone node daemon. Built by "make daemon", run as
+ * 				./Daemon <testcase.conf> <node id> [ticks], one process per
+ * 				node on the same host. Node 1 is the introducer and should
+ * 				be started first. SIGINT or SIGTERM makes a node leave the
+ * 				group, SIGKILL makes it crash.
+ **********************************/
+
+#include "Daemon.h"
+
+/**
+ * FUNCTION NAME: nowNs
+ *
+ * DESCRIPTION: Nanoseconds elapsed since a monotonic clock reading
+ */
+static long nowNs(struct timespec &since) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec - since.tv_sec) * 1000000000L + (ts.tv_nsec - since.tv_nsec);
+}
+
+/**
+ * FUNCTION NAME: percentile
+ *
+ * DESCRIPTION: The q-th quantile of a set of samples, 0 if there are none
+ */
+static long percentile(vector<long> samples, double q) {
+	if ( samples.empty() ) {
+		return 0;
+	}
+	size_t k = min(samples.size() - 1, (size_t)(q * samples.size()));
+	nth_element(samples.begin(), samples.begin() + k, samples.end());
+	return samples[k];
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: main function of the daemon
+ **********************************/
+int main(int argc, char *argv[]) {
+	if ( argc < DAEMON_ARGS_MIN || argc > DAEMON_ARGS_MAX ) {
+		cout<<"Usage: Daemon <testcase.conf> <node id> [ticks]"<<endl;
+		return FAILURE;
+	}
+	int ticks = argc == DAEMON_ARGS_MAX ? atoi(argv[3]) : DAEMON_TICKS;
+
+	Daemon *daemon = new Daemon(argv[1], atoi(argv[2]), ticks);
+	daemon->run();
+	delete daemon;
+
+	return SUCCESS;
+}
+
+/**
+ * Constructor of the Daemon class
+ */
+Daemon::Daemon(char *conf, int id, int ticks): id(id), epfd(-1), timerfd(-1), sigfd(-1), overruns(0), recvWakeups(0) {
+	par = new Params();
+	par->setparams(conf);
+	if ( id < 1 || id > par->EN_GPSZ ) {
+		cerr << "node id must be between 1 and " << par->EN_GPSZ << endl;
+		exit(1);
+	}
+	this->ticks = max(1, min(ticks, DAEMON_MAX_TICKS));
+	if ( this->ticks != ticks ) {
+		cerr << "running " << this->ticks << " ticks instead of " << ticks << ", heartbeats are stored in 16 bits" << endl;
+	}
+	// DROP_MSG drops messages for the whole run
+	par->dropmsg = par->DROP_MSG;
+	srand(time(NULL) ^ (id << 16));
+
+	log = new Log(par);
+	log->setInstance(id);
+	en = new EmulNet(par);
+	if ( !en->ENlisten(id) ) {
+		perror("ENlisten");
+		exit(1);
+	}
+	Address addr;
+	en->ENinit(&addr, par->PORTNUM);
+	member = new Member;
+	member->inited = false;
+	node = MP1Node::create(member, par, en, log, &addr);
+	log->LOG(&member->addr, "APP");
+}
+
+/**
+ * Destructor
+ */
+Daemon::~Daemon() {
+	if ( epfd >= 0 ) {
+		close(epfd);
+	}
+	if ( timerfd >= 0 ) {
+		close(timerfd);
+	}
+	if ( sigfd >= 0 ) {
+		close(sigfd);
+	}
+	delete node;
+	delete member;
+	delete en;
+	delete log;
+	delete par;
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Join the group, then run the node every TICK_MS until the
+ * 				last tick or a signal
+ */
+int Daemon::run() {
+	char JOINADDR[30];
+	struct itimerspec period;
+	struct epoll_event event;
+	struct epoll_event events[DAEMON_EVENTS];
+	sigset_t mask;
+	bool running = true;
+
+	// SIGINT and SIGTERM are read from a signalfd instead of interrupting the loop
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	sigfd = signalfd(-1, &mask, SFD_NONBLOCK);
+
+	timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	epfd = epoll_create1(0);
+	if ( sigfd < 0 || timerfd < 0 || epfd < 0 ) {
+		perror("Daemon");
+		return FAILURE;
+	}
+	int fds[] = { timerfd, en->ENfd(), sigfd };
+	for ( int fd : fds ) {
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+	}
+
+	par->globaltime = 0;
+	node->nodeStart(JOINADDR, par->PORTNUM);
+	cout << "node " << id << " started with the address " << member->addr.getAddress() << endl;
+
+	period.it_interval.tv_sec = par->TICK_MS / 1000;
+	period.it_interval.tv_nsec = (par->TICK_MS % 1000) * 1000000L;
+	period.it_value = period.it_interval;
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	timerfd_settime(timerfd, 0, &period, NULL);
+
+	while ( running && par->globaltime < ticks ) {
+		int ready = epoll_wait(epfd, events, DAEMON_EVENTS, -1);
+		if ( ready < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			perror("epoll_wait");
+			break;
+		}
+		for ( int i = 0; i < ready; i++ ) {
+			int fd = events[i].data.fd;
+			if ( fd == timerfd ) {
+				uint64_t expirations;
+				if ( read(timerfd, &expirations, sizeof(expirations)) == sizeof(expirations) ) {
+					onTick(expirations);
+				}
+			}
+			else if ( fd == sigfd ) {
+				struct signalfd_siginfo info;
+				if ( read(sigfd, &info, sizeof(info)) == sizeof(info) ) {
+					running = false;
+				}
+			}
+			// Messages are taken off the socket as they arrive, and handled at the next tick
+			else {
+				recvWakeups++;
+				node->recvLoop();
+			}
+		}
+	}
+
+	node->leaveGroup();
+	report();
+	node->logSweepStats();
+	en->ENcleanup();
+
+	return SUCCESS;
+}
+
+/**
+ * FUNCTION NAME: onTick
+ *
+ * DESCRIPTION: Advance the clock by the ticks that passed and run the
+ * 				protocol once. Ticks missed while an earlier loop ran late
+ * 				are skipped, not run back to back, so getcurrtime keeps
+ * 				following the wall clock.
+ */
+void Daemon::onTick(uint64_t expirations) {
+	long tickNs = par->TICK_MS * 1000000L;
+	long due = (par->globaltime + (long) expirations) * tickNs;
+	long start = nowNs(started);
+
+	overruns += expirations - 1;
+	par->globaltime = (int) min(par->globaltime + (long) expirations, (long) ticks);
+	if ( par->globaltime >= ticks ) {
+		return;
+	}
+	lagNs.push_back(start - due);
+
+	node->recvLoop();
+	node->nodeLoop();
+	loopNs.push_back(nowNs(started) - start);
+}
+
+/**
+ * FUNCTION NAME: report
+ *
+ * DESCRIPTION: Print CPU usage and the protocol loop latency distribution,
+ * 				and write them to the stats log
+ */
+void Daemon::report() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double userMs = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+	double sysMs = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+	double wallMs = nowNs(started) / 1000000.0;
+
+	char line[512];
+	sprintf(line, "#STATSLOG# daemon ticks=%d tick_ms=%d cpu_user_ms=%.1f cpu_sys_ms=%.1f cpu_pct=%.3f loop_p50_us=%.1f loop_p99_us=%.1f loop_p999_us=%.1f loop_max_us=%.1f lag_p50_us=%.1f lag_p99_us=%.1f lag_max_us=%.1f overruns=%ld recv_wakeups=%ld sent=%ld",
+		par->getcurrtime(), par->TICK_MS, userMs, sysMs, wallMs > 0 ? 100 * (userMs + sysMs) / wallMs : 0,
+		percentile(loopNs, 0.5) / 1000.0, percentile(loopNs, 0.99) / 1000.0, percentile(loopNs, 0.999) / 1000.0, percentile(loopNs, 1) / 1000.0,
+		percentile(lagNs, 0.5) / 1000.0, percentile(lagNs, 0.99) / 1000.0, percentile(lagNs, 1) / 1000.0,
+		overruns, recvWakeups, en->getSentMessages());
+	log->LOG(&member->addr, line);
+	cout << "node " << id << " " << line + strlen("#STATSLOG# ") << endl;
+}
@@ -0,0 +1,69 @@
+/**********************************
+ * FILE NAME: Daemon.h
+ *
+ * DESCRIPTION: Header file of the standalone node daemon
+ **********************************/
+
+#ifndef _DAEMON_H_
+#define _DAEMON_H_
+
+#include "stdincludes.h"
+#include "MP1Node.h"
+#include "Log.h"
+#include "Params.h"
+#include "Member.h"
+#include "EmulNet.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+
+/*
+ * Macros
+ */
+#define DAEMON_ARGS_MIN 3
+#define DAEMON_ARGS_MAX 4
+#define DAEMON_TICKS 600
+// member entries hold heartbeats and timestamps in 16 bits, with room for resumed heartbeats
+#define DAEMON_MAX_TICKS (USHRT_MAX - 1000)
+#define DAEMON_EVENTS 4
+
+/**
+ * CLASS NAME: Daemon
+ *
+ * DESCRIPTION: Runs one node in its own process in real time. A timerfd
+ * 				expiring every TICK_MS advances the node's clock, an epoll loop
+ * 				waits on it, on the node's UDP socket and on SIGINT/SIGTERM.
+ * 				Records how long each protocol loop takes and how late each
+ * 				tick starts.
+ */
+class Daemon {
+private:
+	Params *par;
+	EmulNet *en;
+	Log *log;
+	Member *member;
+	MP1Node *node;
+	int id;
+	int ticks;
+	int epfd;
+	int timerfd;
+	int sigfd;
+	struct timespec started;
+	// nanoseconds spent in each tick's protocol loop
+	vector<long> loopNs;
+	// nanoseconds between each tick's due time and the loop starting
+	vector<long> lagNs;
+	// ticks whose loop did not run because an earlier one ran late
+	long overruns;
+	// wakeups by the socket alone
+	long recvWakeups;
+	void onTick(uint64_t expirations);
+	void report();
+public:
+	Daemon(char *conf, int id, int ticks);
+	virtual ~Daemon();
+	int run();
+};
+
+#endif /* _DAEMON_H_ */
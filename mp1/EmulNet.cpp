@@ -12,17 +12,31 @@
 EmulNet::EmulNet(Params *p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
+	int i;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
+	bufferedBytes = 0;
+	shedMessages = 0;
+	sentMessages = 0;
+	sentBytes = 0;
+	backpressured = 0;
+	transport = NULL;
+	shard = 0;
+	shards = 1;
+	trace = NULL;
+	traceMode = 0;
+	replayHeld = false;
+	sock = -1;
+	listenId = 0;
+	countedTick = 0;
+	controlLane.settCurrBuffSize(0);
+	controlHeld = 0;
+	for ( i = 0; i < EN_MSG_TYPES; i++ ) {
+		laneOfType[i] = EN_LANE_ROUTINE;
 	}
+	fitNode(par->EN_GPSZ);
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
@@ -30,32 +44,70 @@ EmulNet::EmulNet(Params *p)
  * Copy constructor
  */
 EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
 	this->emulnet = anotherEmulNet.emulnet;
+	this->inflight = anotherEmulNet.inflight;
+	this->linkBusyUntil = anotherEmulNet.linkBusyUntil;
+	this->bufferedBytes = anotherEmulNet.bufferedBytes;
+	this->shedMessages = anotherEmulNet.shedMessages;
+	this->sentMessages = anotherEmulNet.sentMessages;
+	this->sentBytes = anotherEmulNet.sentBytes;
+	this->backpressured = anotherEmulNet.backpressured;
+	this->queuedFor = anotherEmulNet.queuedFor;
+	this->transport = anotherEmulNet.transport;
+	this->shard = anotherEmulNet.shard;
+	this->shards = anotherEmulNet.shards;
+	this->trace = anotherEmulNet.trace;
+	this->traceMode = anotherEmulNet.traceMode;
+	memcpy(this->replayHeader, anotherEmulNet.replayHeader, sizeof(replayHeader));
+	this->replayHeld = anotherEmulNet.replayHeld;
+	this->sock = anotherEmulNet.sock;
+	this->listenId = anotherEmulNet.listenId;
+	this->countedTick = anotherEmulNet.countedTick;
+	this->controlLane = anotherEmulNet.controlLane;
+	this->controlHeld = anotherEmulNet.controlHeld;
+	memcpy(this->laneOfType, anotherEmulNet.laneOfType, sizeof(laneOfType));
+	memcpy(this->sizeByType, anotherEmulNet.sizeByType, sizeof(sizeByType));
+	this->inboxDepth = anotherEmulNet.inboxDepth;
+	memcpy(this->handlingByType, anotherEmulNet.handlingByType, sizeof(handlingByType));
 }
 
 /**
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
 	this->emulnet = anotherEmulNet.emulnet;
+	this->inflight = anotherEmulNet.inflight;
+	this->linkBusyUntil = anotherEmulNet.linkBusyUntil;
+	this->bufferedBytes = anotherEmulNet.bufferedBytes;
+	this->shedMessages = anotherEmulNet.shedMessages;
+	this->sentMessages = anotherEmulNet.sentMessages;
+	this->sentBytes = anotherEmulNet.sentBytes;
+	this->backpressured = anotherEmulNet.backpressured;
+	this->queuedFor = anotherEmulNet.queuedFor;
+	this->transport = anotherEmulNet.transport;
+	this->shard = anotherEmulNet.shard;
+	this->shards = anotherEmulNet.shards;
+	this->trace = anotherEmulNet.trace;
+	this->traceMode = anotherEmulNet.traceMode;
+	memcpy(this->replayHeader, anotherEmulNet.replayHeader, sizeof(replayHeader));
+	this->replayHeld = anotherEmulNet.replayHeld;
+	this->sock = anotherEmulNet.sock;
+	this->listenId = anotherEmulNet.listenId;
+	this->countedTick = anotherEmulNet.countedTick;
+	this->controlLane = anotherEmulNet.controlLane;
+	this->controlHeld = anotherEmulNet.controlHeld;
+	memcpy(this->laneOfType, anotherEmulNet.laneOfType, sizeof(laneOfType));
+	memcpy(this->sizeByType, anotherEmulNet.sizeByType, sizeof(sizeByType));
+	this->inboxDepth = anotherEmulNet.inboxDepth;
+	memcpy(this->handlingByType, anotherEmulNet.handlingByType, sizeof(handlingByType));
 	return *this;
 }
 
@@ -71,44 +123,105 @@ EmulNet::~EmulNet() {}
  */
 void *EmulNet::ENinit(Address *myaddr, short port) {
 	// Initialize data structures for this member
-	*(int *)(myaddr->addr) = emulnet.nextid++;
-    *(short *)(&myaddr->addr[4]) = 0;
+	*myaddr = NodeId(emulnet.nextid++, 0).toAddress();
 	return myaddr;
 }
 
 /**
  * FUNCTION NAME: ENsend
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: EmulNet send function. When replaying a trace the message goes
+ * 				through the same checks and is then discarded, what the nodes
+ * 				receive comes from the trace instead.
+ *
+ * 				Control lane messages follow their lane's policy, see en_lane.
  *
  * RETURNS:
- * size
+ * size, 0 if the message was lost, EN_BACKPRESSURE if it was refused
+ * because the network, the sender's quota or the destination's queue is full
  */
 int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 	en_msg *em;
 	static char temp[2048];
+	en_lane lane = EN_LANE_ROUTINE;
+
+	if( size >= (int)sizeof(int) ) {
+		sizeByType[typeSlot(*(int *)data)].record(size);
+		lane = ENlane(*(int *)data);
+	}
+
+	if( !ENcanSend(myaddr, toaddr, lane) ) {
+		backpressured++;
+		traceSend(myaddr, toaddr, data, size, 0, EN_REFUSED);
+		return EN_BACKPRESSURE;
+	}
+
 	int sendmsg = rand() % 100;
+	double dropProb = lane == EN_LANE_CONTROL ? par->EN_CONTROL_DROP_PROB : par->MSG_DROP_PROB;
+	if( (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (dropProb * 100)) ) {
+		traceSend(myaddr, toaddr, data, size, 0, EN_DROPPED);
+		return 0;
+	}
+
+	int src = NodeId(*myaddr).getid();
+	int dst = NodeId(*toaddr).getid();
+	int time = par->getcurrtime();
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+	if( isPartitioned(src, dst) ) {
+		traceSend(myaddr, toaddr, data, size, 0, EN_PARTITIONED);
 		return 0;
 	}
 
+	if( lane == EN_LANE_ROUTINE && par->EN_MEM_BUDGET > 0 && bufferedBytes + (long)sizeof(en_msg) + size > par->EN_MEM_BUDGET ) {
+		shedMessages++;
+		traceSend(myaddr, toaddr, data, size, 0, EN_SHED);
+		return 0;
+	}
+
+	int deliverAt = deliveryTime(src, dst, size);
+	traceSend(myaddr, toaddr, data, size, deliverAt, EN_DELIVERED);
+
+	if( traceMode == EN_TRACE_REPLAY ) {
+		tickCount(sent_msgs, src)++;
+		sentMessages++;
+		sentBytes += size;
+		return size;
+	}
+
 	em = (en_msg *)malloc(sizeof(en_msg) + size);
+	bufferedBytes += sizeof(en_msg) + size;
 	em->size = size;
+	em->deliverAt = deliverAt;
 
 	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
 	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
 	memcpy(em + 1, data, size);
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
-
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
-
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+	// A standalone node's messages leave through its UDP socket
+	if( sock >= 0 ) {
+		bool queued = sendDatagram(em, dst);
+		bufferedBytes -= sizeof(en_msg) + size;
+		free(em);
+		if( !queued ) {
+			return 0;
+		}
+	}
+	// Messages for another shard's nodes leave through its ring
+	else if( transport != NULL && shardOf(dst) != shard ) {
+		bool queued = transport->push(shard, shardOf(dst), (char *)em, sizeof(en_msg) + size);
+		bufferedBytes -= sizeof(en_msg) + size;
+		free(em);
+		if( !queued ) {
+			return 0;
+		}
+	}
+	else {
+		enqueue(em, time);
+	}
 
-	sent_msgs[src][time]++;
+	tickCount(sent_msgs, src)++;
+	sentMessages++;
+	sentBytes += size;
 
 	#ifdef DEBUGLOG
 		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
@@ -117,6 +230,38 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 	return size;
 }
 
+/**
+ * FUNCTION NAME: enqueue
+ *
+ * DESCRIPTION: Hold a message sent at tick sentAt for its destination.
+ * 				Undelayed messages go straight to the receive buffer.
+ */
+void EmulNet::enqueue(en_msg *em, int sentAt) {
+	hold(em, em->deliverAt <= sentAt + 1);
+}
+
+/**
+ * FUNCTION NAME: hold
+ *
+ * DESCRIPTION: Keep a message in its lane's receive buffer or in flight,
+ * 				and count it against its destination and its lane
+ */
+void EmulNet::hold(en_msg *em, bool inBuffer) {
+	en_lane lane = laneOf(em);
+	if( inBuffer ) {
+		bufferOf(lane).add(NodeId(em->to).getid(), em);
+	}
+	else {
+		inflight.push(em);
+	}
+	int dst = NodeId(em->to).getid();
+	fitNode(dst);
+	queuedFor[dst]++;
+	if( lane == EN_LANE_CONTROL ) {
+		controlHeld++;
+	}
+}
+
 /**
  * FUNCTION NAME: ENsend
  *
@@ -136,46 +281,670 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
 /**
  * FUNCTION NAME: ENrecv
  *
- * DESCRIPTION: EmulNet receive function
+ * DESCRIPTION: EmulNet receive function. Control lane messages are handed
+ * 				over first, so a full inbox turns routine messages away.
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
+	NodeId me(*myaddr);
+
+	replayDue();
+	if( sock >= 0 ) {
+		recvDatagrams();
+	}
+	releaseDue();
+
+	deliver(controlLane, me, enq, queue);
+	deliver(emulnet, me, enq, queue);
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: deliver
+ *
+ * DESCRIPTION: Hand a node the messages a lane's buffer holds for it
+ */
+void EmulNet::deliver(EM &buffer, NodeId me, int (* enq)(void *, char *, int), void *queue) {
 	int i;
+	int kept = 0;
 	char* tmp;
 	int sz;
 	en_msg *emsg;
+	int dst = me.getid();
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
+	if ( dst >= (int) buffer.buff.size() ) {
+		return;
+	}
+	vector<en_msg *> &held = buffer.buff[dst];
+	for( i = 0; i < (int) held.size(); i++ ) {
+		emsg = held[i];
 
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+		// compares all six address bytes, the port included
+		if ( !(NodeId(emsg->to) == me) ) {
+			held[kept++] = emsg;
+			continue;
+		}
+		sz = emsg->size;
+		tmp = (char *) malloc(sz * sizeof(char));
+		memcpy(tmp, (char *)(emsg+1), sz);
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+		buffer.currbuffsize--;
 
-			(*enq)(queue, (char *)tmp, sz);
+		(*enq)(queue, (char *)tmp, sz);
 
-			free(emsg);
+		bufferedBytes -= sizeof(en_msg) + sz;
+		free(emsg);
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+		tickCount(recv_msgs, dst)++;
+		queuedFor[dst]--;
+		if( &buffer == &controlLane ) {
+			controlHeld--;
+		}
+	}
+	held.resize(kept);
+}
+
+/**
+ * FUNCTION NAME: ENcanSend
+ *
+ * DESCRIPTION: Check if ENsend would accept a message now: the network has
+ * 				room, the sender has EN_SEND_QUOTA left this tick and the
+ * 				destination holds fewer than EN_QUEUE_LIMIT messages.
+ * 				Cross-shard destinations are limited by their ring instead.
+ * 				The control lane only needs room in its own buffer.
+ */
+bool EmulNet::ENcanSend(Address *myaddr, Address *toaddr, en_lane lane) {
+	int src = NodeId(*myaddr).getid();
+	int dst = NodeId(*toaddr).getid();
+
+	fitNode(max(src, dst));
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+	if( lane == EN_LANE_CONTROL ) {
+		return controlHeld < min(par->EN_CONTROL_SLOTS, ENBUFFSIZE);
+	}
+	// in-flight control messages do not take routine room
+	int controlInflight = controlHeld - controlLane.currbuffsize;
+	if( emulnet.currbuffsize + (int)inflight.size() - controlInflight >= ENBUFFSIZE ) {
+		return false;
+	}
+	if( par->EN_SEND_QUOTA > 0 && tickCount(sent_msgs, src) >= par->EN_SEND_QUOTA ) {
+		return false;
+	}
+	if( par->EN_QUEUE_LIMIT > 0 && queuedFor[dst] >= par->EN_QUEUE_LIMIT ) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: ENsendsLeft
+ *
+ * DESCRIPTION: Messages the node may still send this tick under EN_SEND_QUOTA
+ */
+int EmulNet::ENsendsLeft(Address *myaddr, en_lane lane) {
+	if( par->EN_SEND_QUOTA <= 0 || lane == EN_LANE_CONTROL ) {
+		return INT_MAX;
+	}
+	return max(0, par->EN_SEND_QUOTA - tickCount(sent_msgs, NodeId(*myaddr).getid()));
+}
 
-			recv_msgs[dst][time]++;
+/**
+ * FUNCTION NAME: ENsetLane
+ *
+ * DESCRIPTION: Send messages of a type in the given lane when EN_PRIORITY_LANES is set
+ */
+void EmulNet::ENsetLane(int msgType, en_lane lane) {
+	laneOfType[typeSlot(msgType)] = lane;
+}
+
+/**
+ * FUNCTION NAME: ENlane
+ *
+ * DESCRIPTION: Lane messages of a type travel in
+ */
+en_lane EmulNet::ENlane(int msgType) {
+	if( !par->EN_PRIORITY_LANES ) {
+		return EN_LANE_ROUTINE;
+	}
+	return laneOfType[typeSlot(msgType)];
+}
+
+/**
+ * FUNCTION NAME: laneOf
+ *
+ * DESCRIPTION: Lane of a message, from the type in its first int
+ */
+en_lane EmulNet::laneOf(en_msg *em) {
+	if( em->size < (int)sizeof(int) ) {
+		return EN_LANE_ROUTINE;
+	}
+	return ENlane(*(int *)(em + 1));
+}
+
+/**
+ * FUNCTION NAME: bufferOf
+ *
+ * DESCRIPTION: Receive buffer of a lane
+ */
+EM &EmulNet::bufferOf(en_lane lane) {
+	return lane == EN_LANE_CONTROL ? controlLane : emulnet;
+}
+
+/**
+ * FUNCTION NAME: netZoneOf
+ *
+ * DESCRIPTION: Network zone of a node, derived from its id range
+ */
+int EmulNet::netZoneOf(int id) {
+	if ( par->NET_ZONE_SIZE <= 0 ) {
+		return 0;
+	}
+	return (id - 1) / par->NET_ZONE_SIZE;
+}
+
+/**
+ * FUNCTION NAME: isPartitioned
+ *
+ * DESCRIPTION: Check if a scheduled partition currently separates two nodes
+ */
+bool EmulNet::isPartitioned(int src, int dst) {
+	int time = par->getcurrtime();
+	for ( auto &partition : par->PARTITIONS ) {
+		if ( time < partition.start || time >= partition.end ) {
+			continue;
+		}
+		if ( (netZoneOf(src) == partition.zone) != (netZoneOf(dst) == partition.zone) ) {
+			return true;
 		}
 	}
+	return false;
+}
 
+/**
+ * FUNCTION NAME: deliveryTime
+ *
+ * DESCRIPTION: Tick at which a message sent now becomes receivable.
+ * 				Without a network model this is always the next tick.
+ * 				A bandwidth cap queues messages behind the sender's earlier
+ * 				traffic, then link latency and jitter are added.
+ */
+int EmulNet::deliveryTime(int src, int dst, int size) {
+	int time = par->getcurrtime();
+	double departure = time;
+
+	if ( par->NET_BANDWIDTH > 0 ) {
+		fitNode(src);
+		departure = max(departure, linkBusyUntil[src]) + (double) size / par->NET_BANDWIDTH;
+		linkBusyUntil[src] = departure;
+	}
+
+	int latency = (netZoneOf(src) == netZoneOf(dst)) ? par->NET_LATENCY_LOCAL : par->NET_LATENCY_REMOTE;
+	if ( par->NET_JITTER > 0 ) {
+		latency += rand() % (par->NET_JITTER + 1);
+	}
+
+	return time + 1 + (int)(departure - time) + latency;
+}
+
+/**
+ * FUNCTION NAME: releaseDue
+ *
+ * DESCRIPTION: Move in-flight messages that have arrived into their lane's receive buffer
+ */
+void EmulNet::releaseDue() {
+	while ( !inflight.empty() && inflight.top()->deliverAt <= par->getcurrtime() ) {
+		EM &buffer = bufferOf(laneOf(inflight.top()));
+		if ( buffer.currbuffsize >= ENBUFFSIZE ) {
+			break;
+		}
+		buffer.add(NodeId(inflight.top()->to).getid(), inflight.top());
+		inflight.pop();
+	}
+}
+
+/**
+ * FUNCTION NAME: ENrecord
+ *
+ * DESCRIPTION: Write every ENsend and what became of it to a trace file,
+ * 				starting with the seed the run was started from
+ */
+bool EmulNet::ENrecord(const char *filename, unsigned int seed) {
+	trace = fopen(filename, "wb");
+	if ( trace == NULL ) {
+		return false;
+	}
+	char header[EN_TRACE_HEADER];
+	memcpy(header, "ENT1", 4);
+	memcpy(header + 4, &par->EN_GPSZ, sizeof(int));
+	memcpy(header + 4 + sizeof(int), &seed, sizeof(int));
+	fwrite(header, EN_TRACE_HEADER, 1, trace);
+	traceMode = EN_TRACE_RECORD;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: ENreplay
+ *
+ * DESCRIPTION: Deliver the messages of a recorded trace instead of the ones
+ * 				nodes send. Returns the seed of the recorded run, so the
+ * 				failure schedule and the nodes' own random choices repeat.
+ */
+bool EmulNet::ENreplay(const char *filename, unsigned int *seed) {
+	trace = fopen(filename, "rb");
+	if ( trace == NULL ) {
+		return false;
+	}
+	char header[EN_TRACE_HEADER];
+	int nodes;
+	if ( fread(header, EN_TRACE_HEADER, 1, trace) != 1 || memcmp(header, "ENT1", 4) != 0 ) {
+		fclose(trace);
+		trace = NULL;
+		return false;
+	}
+	memcpy(&nodes, header + 4, sizeof(int));
+	if ( nodes != par->EN_GPSZ ) {
+		fclose(trace);
+		trace = NULL;
+		return false;
+	}
+	memcpy(seed, header + 4 + sizeof(int), sizeof(int));
+	traceMode = EN_TRACE_REPLAY;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: traceSend
+ *
+ * DESCRIPTION: Append one ENsend to the trace when recording
+ */
+void EmulNet::traceSend(Address *myaddr, Address *toaddr, char *data, int size, int deliverAt, en_outcome outcome) {
+	if ( traceMode != EN_TRACE_RECORD ) {
+		return;
+	}
+	char record[EN_TRACE_RECORD_SIZE];
+	int time = par->getcurrtime();
+	int offset = 0;
+	memcpy(record + offset, &time, sizeof(int));
+	offset += sizeof(int);
+	memcpy(record + offset, &deliverAt, sizeof(int));
+	offset += sizeof(int);
+	memcpy(record + offset, &size, sizeof(int));
+	offset += sizeof(int);
+	memcpy(record + offset, myaddr->addr, 6);
+	offset += 6;
+	memcpy(record + offset, toaddr->addr, 6);
+	offset += 6;
+	record[offset] = (char) outcome;
+	fwrite(record, EN_TRACE_RECORD_SIZE, 1, trace);
+	if ( outcome == EN_DELIVERED ) {
+		fwrite(data, size, 1, trace);
+	}
+}
+
+/**
+ * FUNCTION NAME: replayDue
+ *
+ * DESCRIPTION: Take the messages recorded before the current tick off the trace,
+ * 				in the order they were sent, so receive buffer and in-flight
+ * 				queue evolve as in the recorded run
+ */
+void EmulNet::replayDue() {
+	int time = par->getcurrtime();
+	while ( trace != NULL && traceMode == EN_TRACE_REPLAY ) {
+		if ( !replayHeld ) {
+			if ( fread(replayHeader, EN_TRACE_RECORD_SIZE, 1, trace) != 1 ) {
+				fclose(trace);
+				trace = NULL;
+				return;
+			}
+			replayHeld = true;
+		}
+		int sentAt;
+		memcpy(&sentAt, replayHeader, sizeof(int));
+		if ( sentAt >= time ) {
+			return;
+		}
+		replayHeld = false;
+		if ( replayHeader[EN_TRACE_RECORD_SIZE - 1] != EN_DELIVERED ) {
+			continue;
+		}
+
+		int deliverAt, size;
+		memcpy(&deliverAt, replayHeader + sizeof(int), sizeof(int));
+		memcpy(&size, replayHeader + 2 * sizeof(int), sizeof(int));
+		en_msg *em = (en_msg *)malloc(sizeof(en_msg) + size);
+		em->size = size;
+		em->deliverAt = deliverAt;
+		memcpy(&(em->from.addr), replayHeader + 3 * sizeof(int), 6);
+		memcpy(&(em->to.addr), replayHeader + 3 * sizeof(int) + 6, 6);
+		if ( fread(em + 1, size, 1, trace) != 1 ) {
+			free(em);
+			fclose(trace);
+			trace = NULL;
+			return;
+		}
+		bufferedBytes += sizeof(en_msg) + size;
+		enqueue(em, sentAt);
+	}
+}
+
+/**
+ * FUNCTION NAME: ENlisten
+ *
+ * DESCRIPTION: Turn this EmulNet into the network of a single standalone node.
+ * 				The node gets the given id at ENinit and exchanges messages with
+ * 				the other nodes over UDP on localhost, node i on port PORTNUM + i.
+ */
+bool EmulNet::ENlisten(int id) {
+	struct sockaddr_in local;
+	sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if ( sock < 0 ) {
+		return false;
+	}
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	local.sin_port = htons(par->PORTNUM + id);
+	if ( bind(sock, (struct sockaddr *) &local, sizeof(local)) < 0 ) {
+		close(sock);
+		sock = -1;
+		return false;
+	}
+	emulnet.setNextId(id);
+	listenId = id;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: ENfd
+ *
+ * DESCRIPTION: Socket to wait on for incoming messages, -1 in the simulation
+ */
+int EmulNet::ENfd() {
+	return sock;
+}
+
+/**
+ * FUNCTION NAME: sendDatagram
+ *
+ * DESCRIPTION: Send a message to another standalone node. Its delivery tick
+ * 				travels as a delay, the nodes' tick counters are not aligned.
+ */
+bool EmulNet::sendDatagram(en_msg *em, int dst) {
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	to.sin_port = htons(par->PORTNUM + dst);
+	em->deliverAt -= par->getcurrtime();
+	return sendto(sock, em, sizeof(en_msg) + em->size, 0, (struct sockaddr *) &to, sizeof(to)) >= 0;
+}
+
+/**
+ * FUNCTION NAME: recvDatagrams
+ *
+ * DESCRIPTION: Move everything the socket holds into the in-flight queue,
+ * 				due that many ticks after the current one
+ */
+void EmulNet::recvDatagrams() {
+	static char datagram[EN_DATAGRAM_SIZE];
+	while ( true ) {
+		ssize_t got = recv(sock, datagram, sizeof(datagram), 0);
+		if ( got < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			return;
+		}
+		en_msg *em = (en_msg *) datagram;
+		if ( got < (ssize_t) sizeof(en_msg) || em->size != got - (ssize_t) sizeof(en_msg) ) {
+			continue;
+		}
+		em = (en_msg *) malloc(got);
+		memcpy((char *) em, datagram, got);
+		em->deliverAt += par->getcurrtime();
+		bufferedBytes += got;
+		hold(em, false);
+	}
+}
+
+/**
+ * FUNCTION NAME: tickSlot
+ *
+ * DESCRIPTION: Column of the per-tick message counts for the current tick.
+ * 				A daemon can outlive MAX_TIME ticks, so the columns are reused
+ * 				round robin, each cleared when a later tick takes it over.
+ */
+int EmulNet::tickSlot() {
+	int time = par->getcurrtime();
+	while ( countedTick < time ) {
+		countedTick++;
+		if ( countedTick >= MAX_TIME ) {
+			int slot = countedTick % MAX_TIME;
+			for ( int i = 0; i < (int) sent_msgs.size(); i++ ) {
+				if ( slot < (int) sent_msgs[i].size() ) {
+					sent_msgs[i][slot] = 0;
+				}
+				if ( slot < (int) recv_msgs[i].size() ) {
+					recv_msgs[i][slot] = 0;
+				}
+			}
+		}
+	}
+	return time % MAX_TIME;
+}
+
+/**
+ * FUNCTION NAME: fitNode
+ *
+ * DESCRIPTION: Grow the per-node tables to hold node id. They start sized
+ * 				from EN_GPSZ, so this only grows them for ids past the group.
+ */
+void EmulNet::fitNode(int id) {
+	if ( id >= (int) queuedFor.size() ) {
+		queuedFor.resize(id + 1, 0);
+		linkBusyUntil.resize(id + 1, 0);
+		sent_msgs.resize(id + 1);
+		recv_msgs.resize(id + 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: tickCount
+ *
+ * DESCRIPTION: The node's count in counts for the current tick. A node's row
+ * 				only grows to the ticks it was counted in, so nodes that
+ * 				never send or receive here, such as those of other shards,
+ * 				take no columns.
+ */
+int &EmulNet::tickCount(vector<vector<int> > &counts, int id) {
+	int slot = tickSlot();
+	fitNode(id);
+	if ( slot >= (int) counts[id].size() ) {
+		counts[id].resize(slot + 1, 0);
+	}
+	return counts[id][slot];
+}
+
+/**
+ * FUNCTION NAME: countAt
+ *
+ * DESCRIPTION: The node's count in counts for a tick column, 0 where its
+ * 				row never reached
+ */
+int EmulNet::countAt(vector<vector<int> > &counts, int id, int slot) {
+	if ( id >= (int) counts.size() || slot >= (int) counts[id].size() ) {
+		return 0;
+	}
+	return counts[id][slot];
+}
+
+/**
+ * FUNCTION NAME: typeSlot
+ *
+ * DESCRIPTION: Histogram slot of a message type
+ */
+int EmulNet::typeSlot(int msgType) {
+	return (msgType >= 0 && msgType < EN_MSG_TYPES) ? msgType : EN_MSG_TYPES - 1;
+}
+
+/**
+ * FUNCTION NAME: ENnoteInboxDepth
+ *
+ * DESCRIPTION: Record how many messages a node found waiting when it checked its inbox
+ */
+void EmulNet::ENnoteInboxDepth(int depth) {
+	inboxDepth.record(depth);
+}
+
+/**
+ * FUNCTION NAME: ENnoteHandling
+ *
+ * DESCRIPTION: Record how long a node took to handle one message
+ */
+void EmulNet::ENnoteHandling(int msgType, long ns) {
+	handlingByType[typeSlot(msgType)].record(ns);
+}
+
+/**
+ * FUNCTION NAME: printHistogram
+ *
+ * DESCRIPTION: Print one histogram row, nothing if it is empty
+ */
+static void printHistogram(const char *name, Histogram &h) {
+	if ( h.count == 0 ) {
+		return;
+	}
+	printf("%-22s %10ld %10ld %10ld %10ld %10ld %10ld %12.1f\n", name, h.count, h.percentile(0.5), h.percentile(0.9),
+		h.percentile(0.99), h.percentile(0.999), h.highest, h.mean());
+}
+
+/**
+ * FUNCTION NAME: printHistograms
+ *
+ * DESCRIPTION: Print percentiles of the message size, inbox depth and handling time histograms
+ */
+void EmulNet::printHistograms() {
+	char name[40];
+	printf("%-22s %10s %10s %10s %10s %10s %10s %12s\n", "histogram", "count", "p50", "p90", "p99", "p99.9", "max", "mean");
+	for ( int type = 0; type < EN_MSG_TYPES; type++ ) {
+		sprintf(name, "size_bytes[type %d]", type);
+		printHistogram(name, sizeByType[type]);
+	}
+	printHistogram("inbox_depth", inboxDepth);
+	for ( int type = 0; type < EN_MSG_TYPES; type++ ) {
+		sprintf(name, "handling_ns[type %d]", type);
+		printHistogram(name, handlingByType[type]);
+	}
+}
+
+/**
+ * FUNCTION NAME: ENshard
+ *
+ * DESCRIPTION: Restrict this EmulNet to one shard of a multi-process simulation
+ */
+void EmulNet::ENshard(ShmTransport *transport, int shard, int shards) {
+	this->transport = transport;
+	this->shard = shard;
+	this->shards = shards;
+}
+
+/**
+ * FUNCTION NAME: shardOf
+ *
+ * DESCRIPTION: Shard owning a node, the node range is split into contiguous slices
+ */
+int EmulNet::shardOf(int id) {
+	return (int)((long)(id - 1) * shards / par->EN_GPSZ);
+}
+
+/**
+ * FUNCTION NAME: ENsync
+ *
+ * DESCRIPTION: Called once per tick after the shard barrier. Messages from other
+ * 				shards keep their delivery tick and wait in the in-flight queue.
+ */
+void EmulNet::ENsync() {
+	if ( transport != NULL ) {
+		transport->drain(shard, acceptShardMessage, this);
+	}
+}
+
+/**
+ * FUNCTION NAME: acceptShardMessage
+ *
+ * DESCRIPTION: Take ownership of a message copied out of a shard ring
+ */
+int EmulNet::acceptShardMessage(void *env, char *data, int size) {
+	EmulNet *en = (EmulNet *) env;
+	en->bufferedBytes += size;
+	en->hold((en_msg *) data, false);
 	return 0;
 }
 
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Bytes held by the emulated network, message counters included
+ */
+long EmulNet::memoryUsage() {
+	long bytes = sizeof(EmulNet) + bufferedBytes;
+	bytes += queuedFor.capacity() * (sizeof(int) + sizeof(double) + 2 * sizeof(vector<int>));
+	for ( int i = 0; i < (int) sent_msgs.size(); i++ ) {
+		bytes += (sent_msgs[i].capacity() + recv_msgs[i].capacity()) * sizeof(int);
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: getBufferedBytes
+ *
+ * DESCRIPTION: Bytes held by buffered and in-flight messages
+ */
+long EmulNet::getBufferedBytes() {
+	return bufferedBytes;
+}
+
+/**
+ * FUNCTION NAME: getShedMessages
+ *
+ * DESCRIPTION: Number of sends refused because of EN_MEM_BUDGET
+ */
+long EmulNet::getShedMessages() {
+	return shedMessages;
+}
+
+/**
+ * FUNCTION NAME: getSentMessages
+ *
+ * DESCRIPTION: Number of messages accepted by ENsend
+ */
+long EmulNet::getSentMessages() {
+	return sentMessages;
+}
+
+/**
+ * FUNCTION NAME: getSentBytes
+ *
+ * DESCRIPTION: Payload bytes of the messages accepted by ENsend
+ */
+long EmulNet::getSentBytes() {
+	return sentBytes;
+}
+
+/**
+ * FUNCTION NAME: getBackpressured
+ *
+ * DESCRIPTION: Number of sends refused with EN_BACKPRESSURE
+ */
+long EmulNet::getBackpressured() {
+	return backpressured;
+}
+
 /**
  * FUNCTION NAME: ENcleanup
  *
@@ -186,29 +955,58 @@ int EmulNet::ENcleanup() {
 	int i, j;
 	int sent_total, recv_total;
 
-	FILE* file = fopen("msgcount.log", "w+");
+	// Each shard counts only its own nodes
+	char filename[40];
+	if ( listenId > 0 ) {
+		sprintf(filename, "msgcount.%d.log", listenId);
+	}
+	else if ( shards > 1 && shard > 0 ) {
+		sprintf(filename, "msgcount.%d.log", shard);
+	}
+	else {
+		strcpy(filename, "msgcount.log");
+	}
+	FILE* file = fopen(filename, "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( EM *buffer : { &emulnet, &controlLane } ) {
+		for ( vector<en_msg *> &held : buffer->buff ) {
+			for ( en_msg *emsg : held ) {
+				free(emsg);
+			}
+			held.clear();
+		}
+		buffer->currbuffsize = 0;
 	}
+	controlHeld = 0;
+	while(!inflight.empty()) {
+		free(inflight.top());
+		inflight.pop();
+	}
+	bufferedBytes = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
+		if ( listenId > 0 ? i != listenId : shardOf(i) != shard ) {
+			continue;
+		}
 		fprintf(file, "node %3d ", i);
 		sent_total = 0;
 		recv_total = 0;
 
-		for (j = 0; j < par->getcurrtime(); j++) {
+		// a daemon that ran past MAX_TIME ticks only has counts of the last ones
+		for (j = max(0, par->getcurrtime() - MAX_TIME); j < par->getcurrtime(); j++) {
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			int sent = countAt(sent_msgs, i, j % MAX_TIME);
+			int recv = countAt(recv_msgs, i, j % MAX_TIME);
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4d, %4d)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4d %4d\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
@@ -216,5 +1014,14 @@ int EmulNet::ENcleanup() {
 	}
 
 	fclose(file);
+	if ( trace != NULL ) {
+		fclose(trace);
+		trace = NULL;
+	}
+	if ( sock >= 0 ) {
+		close(sock);
+		sock = -1;
+	}
+	printHistograms();
 	return 0;
 }
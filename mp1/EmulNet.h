@@ -7,13 +7,31 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
 #define MAX_TIME 3600
 #define ENBUFFSIZE 30000
+// ENsend result when a queue or quota is full, the send can be retried later
+#define EN_BACKPRESSURE -1
+// EN_TRACE modes and the file the trace lives in
+#define EN_TRACE_RECORD 1
+#define EN_TRACE_REPLAY 2
+#define EN_TRACE_FILE "entrace.bin"
+// "ENT1", group size, rand seed
+#define EN_TRACE_HEADER (4 + 2 * sizeof(int))
+// tick, deliverAt, size, from, to, outcome; delivered records are followed by the payload
+#define EN_TRACE_RECORD_SIZE (3 * sizeof(int) + 2 * 6 + 1)
+// message types told apart by a message's first int, the last slot takes any other
+#define EN_MSG_TYPES 16
+// largest UDP datagram a standalone node reads
+#define EN_DATAGRAM_SIZE 65536
 
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "ShmTransport.h"
+#include "Histogram.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 using namespace std;
 
@@ -27,8 +45,43 @@ typedef struct en_msg {
 	Address from;
 	// Destination node
 	Address to;
+	// First tick at which the message can be received
+	int deliverAt;
 }en_msg;
 
+/**
+ * What ENsend did with a message, as written to the trace
+ */
+enum en_outcome {
+	EN_DELIVERED,
+	EN_DROPPED,
+	EN_PARTITIONED,
+	EN_SHED,
+	EN_REFUSED,
+};
+
+/**
+ * Delivery lanes. With EN_PRIORITY_LANES the control lane has its own buffer
+ * of EN_CONTROL_SLOTS messages and its own drop probability, is exempt from
+ * EN_SEND_QUOTA, EN_QUEUE_LIMIT and EN_MEM_BUDGET, and a node receives its
+ * control messages before its routine ones.
+ */
+enum en_lane {
+	EN_LANE_ROUTINE,
+	EN_LANE_CONTROL,
+};
+
+/**
+ * Struct Name: en_later
+ *
+ * DESCRIPTION: Orders in-flight messages so the earliest delivery is on top
+ */
+struct en_later {
+	bool operator()(const en_msg *a, const en_msg *b) const {
+		return a->deliverAt > b->deliverAt;
+	}
+};
+
 /**
  * Class Name: EM
  */
@@ -37,19 +90,24 @@ public:
 	int nextid;
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
+	// buffered messages by destination id, in the order they were buffered,
+	// so a node's receive only looks at its own. currbuffsize counts them all
+	vector<vector<en_msg *> > buff;
 	EM() {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->buff = anotherEM.buff;
 		return *this;
 	}
+	void add(int id, en_msg *em) {
+		if ( id >= (int) buff.size() ) {
+			buff.resize(id + 1);
+		}
+		buff[id].push_back(em);
+		currbuffsize++;
+	}
 	int getNextId() {
 		return nextid;
 	}
@@ -80,10 +138,73 @@ class EmulNet
 { 	
 private:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// per-tick message counts of each node, rows and columns grow as nodes
+	// and ticks are counted, up to MAX_TIME columns
+	vector<vector<int> > sent_msgs;
+	vector<vector<int> > recv_msgs;
 	int enInited;
 	EM emulnet;
+	// bytes held by buffered and in-flight messages
+	long bufferedBytes;
+	// sends refused to stay within EN_MEM_BUDGET
+	long shedMessages;
+	// messages and payload bytes accepted by ENsend
+	long sentMessages;
+	long sentBytes;
+	// sends refused with EN_BACKPRESSURE
+	long backpressured;
+	// Messages buffered or in flight towards each node
+	vector<int> queuedFor;
+	// Messages still travelling through the modeled network
+	priority_queue<en_msg *, vector<en_msg *>, en_later> inflight;
+	// Tick at which each node's outbound link is free again
+	vector<double> linkBusyUntil;
+	// Cross-shard rings, NULL when the simulation runs in one process
+	ShmTransport *transport;
+	int shard;
+	int shards;
+	// EN_TRACE file, NULL when not tracing or once a replayed trace is used up
+	FILE *trace;
+	int traceMode;
+	// record header read ahead of its tick while replaying
+	char replayHeader[EN_TRACE_RECORD_SIZE];
+	bool replayHeld;
+	// UDP socket of a standalone node and its id, -1 and 0 in the simulation
+	int sock;
+	int listenId;
+	// latest tick the per-tick counts were kept for
+	int countedTick;
+	// buffer of the control lane, emulnet holds the routine one
+	EM controlLane;
+	// control messages buffered or in flight
+	int controlHeld;
+	// lane each message type travels in
+	en_lane laneOfType[EN_MSG_TYPES];
+	// size of every message sent by type, inbox depth when a node checks its
+	// messages, and nanoseconds a node spends handling a message by type
+	Histogram sizeByType[EN_MSG_TYPES];
+	Histogram inboxDepth;
+	Histogram handlingByType[EN_MSG_TYPES];
+	int netZoneOf(int id);
+	bool isPartitioned(int src, int dst);
+	int deliveryTime(int src, int dst, int size);
+	void releaseDue();
+	void enqueue(en_msg *em, int sentAt);
+	void traceSend(Address *myaddr, Address *toaddr, char *data, int size, int deliverAt, en_outcome outcome);
+	void replayDue();
+	bool sendDatagram(en_msg *em, int dst);
+	void recvDatagrams();
+	int tickSlot();
+	void fitNode(int id);
+	int &tickCount(vector<vector<int> > &counts, int id);
+	static int countAt(vector<vector<int> > &counts, int id, int slot);
+	void printHistograms();
+	static int typeSlot(int msgType);
+	en_lane laneOf(en_msg *em);
+	EM &bufferOf(en_lane lane);
+	void hold(en_msg *em, bool inBuffer);
+	void deliver(EM &buffer, NodeId me, int (* enq)(void *, char *, int), void *queue);
+	static int acceptShardMessage(void *env, char *data, int size);
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
@@ -93,7 +214,26 @@ public:
 	int ENsend(Address *myaddr, Address *toaddr, string data);
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	bool ENcanSend(Address *myaddr, Address *toaddr, en_lane lane = EN_LANE_ROUTINE);
+	int ENsendsLeft(Address *myaddr, en_lane lane = EN_LANE_ROUTINE);
+	void ENsetLane(int msgType, en_lane lane);
+	en_lane ENlane(int msgType);
 	int ENcleanup();
+	void ENshard(ShmTransport *transport, int shard, int shards);
+	void ENsync();
+	bool ENrecord(const char *filename, unsigned int seed);
+	bool ENreplay(const char *filename, unsigned int *seed);
+	bool ENlisten(int id);
+	int ENfd();
+	void ENnoteInboxDepth(int depth);
+	void ENnoteHandling(int msgType, long ns);
+	int shardOf(int id);
+	long memoryUsage();
+	long getBufferedBytes();
+	long getShedMessages();
+	long getSentMessages();
+	long getSentBytes();
+	long getBackpressured();
 };
 
 #endif /* _EMULNET_H_ */
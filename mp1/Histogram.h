@@ -0,0 +1,81 @@
+/**********************************
+ * FILE NAME: Histogram.h
+ *
+ * DESCRIPTION: Log-bucketed histogram of non-negative values, cheap enough
+ * 				to record in the per-message paths
+ **********************************/
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include "stdincludes.h"
+
+/**
+ * Macros
+ */
+// every power of two is split into 2^HIST_SUB_BITS buckets, values are kept within 12.5%
+#define HIST_SUB_BITS 3
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS) * HIST_SUB_BUCKETS)
+
+/**
+ * CLASS NAME: Histogram
+ *
+ * DESCRIPTION: HDR-style histogram: values below HIST_SUB_BUCKETS are counted
+ * 				exactly, larger ones in buckets whose width grows with the value
+ */
+class Histogram {
+public:
+	long counts[HIST_BUCKETS];
+	long count;
+	long sum;
+	long highest;
+	Histogram(): count(0), sum(0), highest(0) {
+		memset(counts, 0, sizeof(counts));
+	}
+	static int bucketOf(long value) {
+		if ( value < HIST_SUB_BUCKETS ) {
+			return (int) value;
+		}
+		int shift = 63 - __builtin_clzl(value) - HIST_SUB_BITS;
+		return (shift + 1) * HIST_SUB_BUCKETS + (int)((value >> shift) & (HIST_SUB_BUCKETS - 1));
+	}
+	/**
+	 * Smallest value counted in a bucket
+	 */
+	static long lowestOf(int bucket) {
+		if ( bucket < HIST_SUB_BUCKETS ) {
+			return bucket;
+		}
+		int shift = bucket / HIST_SUB_BUCKETS - 1;
+		return (long)(HIST_SUB_BUCKETS + bucket % HIST_SUB_BUCKETS) << shift;
+	}
+	void record(long value) {
+		value = value < 0 ? 0 : value;
+		counts[bucketOf(value)]++;
+		count++;
+		sum += value;
+		if ( value > highest ) {
+			highest = value;
+		}
+	}
+	/**
+	 * Highest value of the bucket holding the q-th quantile, never above the highest value recorded
+	 */
+	long percentile(double q) {
+		long rank = max(1L, (long) ceil(q * count));
+		long seen = 0;
+		for ( int bucket = 0; bucket < HIST_BUCKETS; bucket++ ) {
+			seen += counts[bucket];
+			if ( seen >= rank ) {
+				return bucket + 1 < HIST_BUCKETS ? min(highest, lowestOf(bucket + 1) - 1) : highest;
+			}
+		}
+		return highest;
+	}
+	double mean() {
+		return count > 0 ? (double) sum / count : 0;
+	}
+};
+
+#endif /* _HISTOGRAM_H_ */
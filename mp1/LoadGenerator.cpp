@@ -0,0 +1,134 @@
+/**********************************
+ * FILE NAME: LoadGenerator.cpp
+ *
+ * DESCRIPTION: Application traffic sent between live members through
+ * 				EmulNet, competing with the membership protocol
+ **********************************/
+
+#include "LoadGenerator.h"
+
+/**
+ * Constructor
+ */
+LoadGenerator::LoadGenerator(Params *par, EmulNet *en, Member **nodes, int shard): par(par), en(en), nodes(nodes),
+	shard(shard), cdf(par->EN_GPSZ), sent(0), sentBytes(0), lost(0), refused(0) {
+	double total = 0;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		total += 1.0 / pow(i + 1, par->APP_SKEW);
+		cdf[i] = total;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		cdf[i] /= total;
+	}
+
+	// message type, the tick it was sent at, then filler
+	size = max(par->APP_SIZE, (int)(sizeof(MessageHdr) + sizeof(int)));
+	payload = (char *) malloc(size);
+	memset(payload, 0, size);
+	((MessageHdr *)payload)->msgType = APPDATA;
+}
+
+/**
+ * Destructor
+ */
+LoadGenerator::~LoadGenerator() {
+	free(payload);
+}
+
+/**
+ * FUNCTION NAME: isLive
+ *
+ * DESCRIPTION: Ground truth: the node has joined the group and has not failed.
+ * 				A node run by another shard is only an address stub here,
+ * 				but every shard fails the same nodes at the same tick, so it
+ * 				counts as live once Application has introduced it.
+ */
+bool LoadGenerator::isLive(int index) {
+	Member *member = nodes[index];
+	if ( en->shardOf(index + 1) != shard ) {
+		return par->getcurrtime() > (int)(par->STEP_RATE*index) && !member->bFailed;
+	}
+	return member->inGroup && !member->bFailed;
+}
+
+/**
+ * FUNCTION NAME: pickDestination
+ *
+ * DESCRIPTION: Draw a node index from the destination distribution
+ */
+int LoadGenerator::pickDestination() {
+	double u = rand() / (RAND_MAX + 1.0);
+	int index = upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+	return min(index, par->EN_GPSZ - 1);
+}
+
+/**
+ * FUNCTION NAME: generate
+ *
+ * DESCRIPTION: Send this tick's application messages of one running node.
+ * 				Draws that land on the node itself or on a node that is not
+ * 				live are not sent.
+ */
+void LoadGenerator::generate(int index) {
+	int count = (int) par->APP_RATE;
+	if ( rand() / (RAND_MAX + 1.0) < par->APP_RATE - count ) {
+		count++;
+	}
+
+	int time = par->getcurrtime();
+	memcpy(payload + sizeof(MessageHdr), &time, sizeof(int));
+	Address *from = &nodes[index]->addr;
+	for ( int i = 0; i < count; i++ ) {
+		int dst = pickDestination();
+		if ( dst == index || !isLive(dst) ) {
+			continue;
+		}
+		int ret = en->ENsend(from, &nodes[dst]->addr, payload, size);
+		if ( ret == EN_BACKPRESSURE ) {
+			refused++;
+		}
+		else if ( ret == 0 ) {
+			lost++;
+		}
+		else {
+			sent++;
+			sentBytes += size;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: getSent
+ *
+ * DESCRIPTION: Number of application messages accepted by EmulNet
+ */
+long LoadGenerator::getSent() {
+	return sent;
+}
+
+/**
+ * FUNCTION NAME: getSentBytes
+ *
+ * DESCRIPTION: Payload bytes of the application messages accepted by EmulNet
+ */
+long LoadGenerator::getSentBytes() {
+	return sentBytes;
+}
+
+/**
+ * FUNCTION NAME: getLost
+ *
+ * DESCRIPTION: Number of application messages dropped, partitioned or shed by EmulNet
+ */
+long LoadGenerator::getLost() {
+	return lost;
+}
+
+/**
+ * FUNCTION NAME: getRefused
+ *
+ * DESCRIPTION: Number of application sends refused with EN_BACKPRESSURE
+ */
+long LoadGenerator::getRefused() {
+	return refused;
+}
@@ -0,0 +1,54 @@
+/**********************************
+ * FILE NAME: LoadGenerator.h
+ *
+ * DESCRIPTION: Application traffic sent between live members through
+ * 				EmulNet, competing with the membership protocol
+ **********************************/
+
+#ifndef _LOADGENERATOR_H_
+#define _LOADGENERATOR_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "EmulNet.h"
+#include "MP1Node.h"
+
+/**
+ * CLASS NAME: LoadGenerator
+ *
+ * DESCRIPTION: Every running node sends APP_RATE messages of APP_SIZE bytes per
+ * 				tick on average. Destinations follow a Zipf law of exponent
+ * 				APP_SKEW over node ids, 0 picks them uniformly.
+ */
+class LoadGenerator {
+private:
+	Params *par;
+	EmulNet *en;
+	// every node's Member, stubs for the nodes of other shards
+	Member **nodes;
+	// shard of the process this generator runs in
+	int shard;
+	// cumulative destination probabilities, by node index
+	vector<double> cdf;
+	char *payload;
+	int size;
+	// messages accepted by EmulNet and their payload bytes
+	long sent;
+	long sentBytes;
+	// messages EmulNet lost, and sends it refused with EN_BACKPRESSURE
+	long lost;
+	long refused;
+	bool isLive(int index);
+	int pickDestination();
+public:
+	LoadGenerator(Params *par, EmulNet *en, Member **nodes, int shard);
+	virtual ~LoadGenerator();
+	void generate(int index);
+	long getSent();
+	long getSentBytes();
+	long getLost();
+	long getRefused();
+};
+
+#endif /* _LOADGENERATOR_H_ */
@@ -12,6 +12,7 @@
 Log::Log(Params *p) {
 	par = p;
 	firstTime = false;
+	instance = 0;
 }
 
 /**
@@ -20,6 +21,7 @@ Log::Log(Params *p) {
 Log::Log(const Log &anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->instance = anotherLog.instance;
 }
 
 /**
@@ -28,6 +30,7 @@ Log::Log(const Log &anotherLog) {
 Log& Log::operator = (const Log& anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->instance = anotherLog.instance;
 	return *this;
 }
 
@@ -36,6 +39,16 @@ Log& Log::operator = (const Log& anotherLog) {
  */
 Log::~Log() {}
 
+/**
+ * FUNCTION NAME: setInstance
+ *
+ * DESCRIPTION: Give the logs of a standalone node their own file names.
+ * 				Must be called before the first LOG.
+ */
+void Log::setInstance(int id) {
+	instance = id;
+}
+
 /**
  * FUNCTION NAME: LOG
  *
@@ -48,7 +61,7 @@ void Log::LOG(Address *addr, const char * str, ...) {
 	va_list vararglist;
 	static char buffer[30000];
 	static int numwrites;
-	static char stdstring[30];
+	static char stdstring[100];
 	static char stdstring2[40];
 	static char stdstring3[40]; 
 	static int dbg_opened=0;
@@ -60,8 +73,14 @@ void Log::LOG(Address *addr, const char * str, ...) {
 
 		strcpy(stdstring3, stdstring2);
 
-		strcat(stdstring2, DBG_LOG);
-		strcat(stdstring3, STATS_LOG);
+		if(instance > 0){
+			sprintf(stdstring2, "dbg.%d.log", instance);
+			sprintf(stdstring3, "stats.%d.log", instance);
+		}
+		else{
+			strcat(stdstring2, DBG_LOG);
+			strcat(stdstring3, STATS_LOG);
+		}
 
 		fp = fopen(stdstring2, "w");
 		fp2 = fopen(stdstring3, "w");
@@ -125,7 +144,27 @@ void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
  * DESCRIPTION: To log a node remove
  */
 void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
-	static char stdstring[30];
+	static char stdstring[100];
 	sprintf(stdstring, "Node %d.%d.%d.%d:%d removed at time %d", removedAddr->addr[0], removedAddr->addr[1], removedAddr->addr[2], removedAddr->addr[3], *(short *)&removedAddr->addr[4], par->getcurrtime());
     LOG(thisNode, stdstring);
 }
+
+/**
+ * FUNCTION NAME: logNodeAdd
+ *
+ * DESCRIPTION: To Log a node add, by packed id
+ */
+void Log::logNodeAdd(Address *thisNode, NodeId added) {
+	Address addedAddr = added.toAddress();
+	logNodeAdd(thisNode, &addedAddr);
+}
+
+/**
+ * FUNCTION NAME: logNodeRemove
+ *
+ * DESCRIPTION: To log a node remove, by packed id
+ */
+void Log::logNodeRemove(Address *thisNode, NodeId removed) {
+	Address removedAddr = removed.toAddress();
+	logNodeRemove(thisNode, &removedAddr);
+}
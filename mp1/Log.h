@@ -29,14 +29,19 @@ class Log{
 private:
 	Params *par;
 	bool firstTime;
+	// node id of a standalone node, its logs are dbg.<id>.log and stats.<id>.log
+	int instance;
 public:
 	Log(Params *p);
 	Log(const Log &anotherLog);
 	Log& operator = (const Log &anotherLog);
 	virtual ~Log();
+	void setInstance(int id);
 	void LOG(Address *, const char * str, ...);
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
+	void logNodeAdd(Address *, NodeId);
+	void logNodeRemove(Address *, NodeId);
 };
 
 #endif /* _LOG_H_ */
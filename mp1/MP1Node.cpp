@@ -18,7 +18,9 @@
  * You can add new members to the class if you think it
  * is necessary for your logic to work
  */
-MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
+template <class PeerSelector, class FailureDetector, class Codec>
+MP1NodeT<PeerSelector, FailureDetector, Codec>::MP1NodeT(Member *member, Params *params, EmulNet *emul, Log *log, Address *address):
+	selector(params), detector(params) {
 	for( int i = 0; i < 6; i++ ) {
 		NULLADDR[i] = 0;
 	}
@@ -27,12 +29,31 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
 	this->log = log;
 	this->par = params;
 	this->memberNode->addr = *address;
+	this->self = NodeId(*address);
+	this->inboxBytes = 0;
+	this->joinDeferred = false;
+	this->joinSentAt = 0;
+	this->incarnation = 0;
+	this->shedMessages = 0;
+	this->sweepCursor = 0;
+	this->sweepRoundStart = 0;
+	this->sweepExamined = 0;
+	this->sweepMaxSlice = 0;
+	this->sweepMaxRound = 0;
+	this->maxSuspectDelay = 0;
+	this->maxRemovalDelay = 0;
+	// joins, departures and active view changes go in EmulNet's control lane
+	MsgTypes control[] = { JOINREQ, JOINREP, LEAVE, NEIGHBORREQ, DISCONNECT };
+	for ( MsgTypes type : control ) {
+		emul->ENsetLane(type, EN_LANE_CONTROL);
+	}
 }
 
 /**
  * Destructor of the MP1Node class
  */
-MP1Node::~MP1Node() {}
+template <class PeerSelector, class FailureDetector, class Codec>
+MP1NodeT<PeerSelector, FailureDetector, Codec>::~MP1NodeT() {}
 
 /**
  * FUNCTION NAME: recvLoop
@@ -40,12 +61,13 @@ MP1Node::~MP1Node() {}
  * DESCRIPTION: This function receives message from the network and pushes into the queue
  * 				This function is called by a node to receive messages currently waiting for it
  */
-int MP1Node::recvLoop() {
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::recvLoop() {
     if ( memberNode->bFailed ) {
     	return false;
     }
     else {
-    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, &(memberNode->mp1q));
+    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, this);
     }
 }
 
@@ -54,9 +76,33 @@ int MP1Node::recvLoop() {
  *
  * DESCRIPTION: Enqueue the message from Emulnet into the queue
  */
-int MP1Node::enqueueWrapper(void *env, char *buff, int size) {
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::enqueueWrapper(void *env, char *buff, int size) {
+	return ((MP1NodeT *)env)->enqueueMessage(buff, size);
+}
+
+/**
+ * FUNCTION NAME: enqueueMessage
+ *
+ * DESCRIPTION: Queue a received message, shedding the oldest queued messages
+ * 				while the node is over NODE_MEM_BUDGET
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::enqueueMessage(char *buff, int size) {
 	Queue q;
-	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
+	q_elt oldest(NULL, 0);
+	// A full inbox drops the message, the ring counts it
+	if ( !q.enqueue(&(memberNode->mp1q), (void *)buff, size) ) {
+		free(buff);
+		return false;
+	}
+	inboxBytes += size;
+	while ( par->NODE_MEM_BUDGET > 0 && memoryUsage() > par->NODE_MEM_BUDGET && memberNode->mp1q.pop(oldest) ) {
+		inboxBytes -= oldest.size;
+		free(oldest.elt);
+		shedMessages++;
+	}
+	return true;
 }
 
 /**
@@ -66,7 +112,8 @@ int MP1Node::enqueueWrapper(void *env, char *buff, int size) {
  * 				All initializations routines for a member.
  * 				Called by the application layer.
  */
-void MP1Node::nodeStart(char *servaddrstr, short servport) {
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::nodeStart(char *servaddrstr, short servport) {
     Address joinaddr;
     joinaddr = getJoinAddress();
 
@@ -94,13 +141,11 @@ void MP1Node::nodeStart(char *servaddrstr, short servport) {
  *
  * DESCRIPTION: Find out who I am and start up
  */
-int MP1Node::initThisNode(Address *joinaddr) {
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::initThisNode(Address *joinaddr) {
 	/*
 	 * This function is partially implemented and may require changes
 	 */
-	int id = *(int*)(&memberNode->addr.addr);
-	int port = *(short*)(&memberNode->addr.addr[4]);
-
 	memberNode->bFailed = false;
 	memberNode->inited = true;
 	memberNode->inGroup = false;
@@ -110,6 +155,11 @@ int MP1Node::initThisNode(Address *joinaddr) {
 	memberNode->pingCounter = TFAIL;
 	memberNode->timeOutCounter = -1;
     initMemberListTable(memberNode);
+    // the inbox is only allocated once the node runs, so nodes that have
+    // not started yet or belong to another shard hold no slots
+    if ( memberNode->mp1q.capacity() < par->INBOX_SIZE ) {
+        memberNode->mp1q.resize(par->INBOX_SIZE);
+    }
 
     return 0;
 }
@@ -119,7 +169,8 @@ int MP1Node::initThisNode(Address *joinaddr) {
  *
  * DESCRIPTION: Join the distributed system
  */
-int MP1Node::introduceSelfToGroup(Address *joinaddr) {
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::introduceSelfToGroup(Address *joinaddr) {
 	MessageHdr *msg;
 #ifdef DEBUGLOG
     static char s[1024];
@@ -146,7 +197,16 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
         log->LOG(&memberNode->addr, s);
 #endif
         // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize);
+        joinDeferred = emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize) == EN_BACKPRESSURE;
+        joinSentAt = par->getcurrtime();
+
+        // with partial views the introducer answers by taking us into its active view
+        bool requested = std::any_of(neighborRequests.begin(), neighborRequests.end(), [&](MemberListEntry& entry) {
+            return entry.getnode() == NodeId(*joinaddr);
+        });
+        if (PeerSelector::PARTIAL_VIEW && !joinDeferred && !requested) {
+            neighborRequests.push_back(MemberListEntry(NodeId(*joinaddr), 0, par->getcurrtime()));
+        }
 
         free(msg);
     }
@@ -155,15 +215,40 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 
 }
 
+/**
+ * FUNCTION NAME: leaveGroup
+ *
+ * DESCRIPTION: Take this node down. A node still in the group says goodbye
+ * 				with a LEAVE, so the others drop it right away instead of
+ * 				timing it out. A crashed node cannot.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::leaveGroup(){
+    if (memberNode->inGroup && !memberNode->bFailed) {
+        sendLeave(self, ownHeartbeat() + 1);
+    }
+    return finishUpThisNode();
+}
+
 /**
  * FUNCTION NAME: finishUpThisNode
  *
  * DESCRIPTION: Wind up this node and clean up state
  */
-int MP1Node::finishUpThisNode(){
-   /*
-    * Your code goes here
-    */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::finishUpThisNode(){
+    memberNode->inGroup = false;
+    memberNode->memberList.clear();
+    kicklist.clear();
+    passiveView.clear();
+    neighborRequests.clear();
+    pendingJoins.clear();
+    deferredGossip.clear();
+    dissemination.clear();
+    probes.clear();
+    incarnation = 0;
+    sweepCursor = 0;
+    return 0;
 }
 
 /**
@@ -172,68 +257,119 @@ int MP1Node::finishUpThisNode(){
  * DESCRIPTION: Executed periodically at each member
  * 				Check your messages in queue and perform membership protocol duties
  */
-void MP1Node::nodeLoop() {
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::nodeLoop() {
     if (memberNode->bFailed) {
     	return;
     }
 
     // Check my messages
     checkMessages();
+    replyToJoinRequests();
 
     // Wait until you're in the group...
-    if( !memberNode->inGroup ) {
-    	return;
+    if( memberNode->inGroup ) {
+        // ...then jump in and share your responsibilites!
+        nodeLoopOps();
+    }
+    // a lost JOINREQ or JOINREP would leave us out of the group for good
+    else if( joinDeferred || (par->JOIN_RETRY > 0 && par->getcurrtime() - joinSentAt >= par->JOIN_RETRY) ) {
+        Address joinaddr = getJoinAddress();
+        introduceSelfToGroup(&joinaddr);
     }
 
-    // ...then jump in and share your responsibilites!
-    nodeLoopOps();
+    flushMembershipEvents();
 
     return;
 }
 
+#ifdef HAVE_CORO_RUNTIME
+/**
+ * FUNCTION NAME: protocol
+ *
+ * DESCRIPTION: nodeLoop written as a coroutine. The node sleeps until a
+ * 				message arrives or its next protocol period starts, and
+ * 				returns for good once it has failed.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+NodeTask MP1NodeT<PeerSelector, FailureDetector, Codec>::protocol(CoroExecutor *executor, int slot) {
+    int nextPeriod = par->getcurrtime();
+
+    while ( !memberNode->bFailed ) {
+        checkMessages();
+        replyToJoinRequests();
+
+        if( par->getcurrtime() >= nextPeriod ) {
+            if( memberNode->inGroup ) {
+                nodeLoopOps();
+            }
+            else if( joinDeferred || (par->JOIN_RETRY > 0 && par->getcurrtime() - joinSentAt >= par->JOIN_RETRY) ) {
+                Address joinaddr = getJoinAddress();
+                introduceSelfToGroup(&joinaddr);
+            }
+            nextPeriod = par->getcurrtime() + 1;
+        }
+
+        flushMembershipEvents();
+
+        co_await executor->message(slot, nextPeriod);
+    }
+}
+#endif
+
 /**
  * FUNCTION NAME: checkMessages
  *
- * DESCRIPTION: Check messages in the queue and call the respective message handler
+ * DESCRIPTION: Check messages in the queue and call the respective message handler.
+ * 				The inbox depth and the time each handler takes go to the EmulNet histograms.
  */
-void MP1Node::checkMessages() {
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::checkMessages() {
     void *ptr;
     int size;
+    q_elt element(NULL, 0);
+    struct timespec start, end;
+
+    emulNet->ENnoteInboxDepth(memberNode->mp1q.size());
 
     // Pop waiting messages from memberNode's mp1q
-    while ( !memberNode->mp1q.empty() ) {
-    	ptr = memberNode->mp1q.front().elt; 
-    	size = memberNode->mp1q.front().size;
-    	memberNode->mp1q.pop();
+    while ( memberNode->mp1q.pop(element) ) {
+    	ptr = element.elt;
+    	size = element.size;
+    	int msgType = ((MessageHdr *)ptr)->msgType;
+    	clock_gettime(CLOCK_MONOTONIC, &start);
     	recvCallBack((void *)memberNode, (char *)ptr, size);
+    	clock_gettime(CLOCK_MONOTONIC, &end);
+    	emulNet->ENnoteHandling(msgType, (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec));
+    	inboxBytes -= size;
+    	free(ptr);
     }
     return;
 }
 
 
-void MP1Node::updateMemberList(Address& address, long heartbeat) {
-    if ((par->getcurrtime() - heartbeat) > TREMOVE) {
-     return;
-    }
-	int id = *(int*)(&address.addr);
-	int port = *(short*)(&address.addr[4]);
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::updateMemberList(NodeId node, long heartbeat) {
 
     bool existing = false;
     bool updated = false;
+    int peer = PeerDirectory::intern(node);
     vector<MemberListEntry>::iterator it;
     for (it=memberNode->memberList.begin();it < memberNode->memberList.end(); it++) {
 
-        if (it->getid() == id && it->getport() == port) {
+        if (it->peer == peer) {
             existing = true;
             // FIXME update
             if (it->getheartbeat() < heartbeat) {
               it->setheartbeat(heartbeat);
               it->settimestamp(par->getcurrtime());
+              detector.heard(node, par->getcurrtime());
               updated = true;
               // update kicklist
               for (std::vector<MemberListEntry>::iterator value=kicklist.begin();value < kicklist.end(); value++) {
               
-                if (value->getid() == it->getid() && value->getport() == it->getport()) {
+                if (value->peer == it->peer) {
+                  notifyListeners(MEMBER_ALIVE, node, heartbeat);
                   kicklist.erase(value);
                   cout << "restored node " << value->getid() << ":" << value->getport() << endl;
                   break;
@@ -250,19 +386,47 @@ void MP1Node::updateMemberList(Address& address, long heartbeat) {
     }
 
     if (!existing) {
-        MemberListEntry newEntry(id, port, heartbeat, par->getcurrtime());
-        memberNode->memberList.push_back(newEntry);
-        log->logNodeAdd(&memberNode->addr, &address);
+        // stale gossip about a member we already removed
+        if (isTombstoned(node, heartbeat)) {
+            return;
+        }
+        tombstones.erase(std::remove_if(tombstones.begin(), tombstones.end(), [&](MemberListEntry& tombstone) {
+            return tombstone.getnode() == node;
+        }), tombstones.end());
+        // a partial view only takes members in through a neighbor handshake
+        if (PeerSelector::PARTIAL_VIEW) {
+            addPassive(node);
+            return;
+        }
+        if (!isInMyZone(node.getid()) && !admitForeignMember(node.getid())) {
+            return;
+        }
+        addMember(node, heartbeat);
     }
 
 
 }
 
+/**
+ * FUNCTION NAME: addMember
+ *
+ * DESCRIPTION: List a new member and announce it
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::addMember(NodeId node, long heartbeat) {
+    MemberListEntry newEntry(node, heartbeat, par->getcurrtime());
+    memberNode->memberList.push_back(newEntry);
+    detector.heard(node, par->getcurrtime());
+    log->logNodeAdd(&memberNode->addr, node);
+    notifyListeners(MEMBER_JOINED, node, heartbeat);
+    disseminate(node, heartbeat, DISSEMINATE_JOIN);
+}
 
-void MP1Node::mergeMemberlist(Member* member, char* data, int size) {
 
-    // Entry: Address(6 byte) + heartbeat(8 byte) 
-    size_t entrySize = sizeof(memberNode->addr.addr) + sizeof(long);
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::mergeMemberlist(Member* member, char* data, int size) {
+
+    size_t entrySize = Codec::ENTRY_SIZE;
 
     int offset = 0;
     Address sourceAddress;
@@ -284,23 +448,20 @@ void MP1Node::mergeMemberlist(Member* member, char* data, int size) {
             #endif
             exit(1);
         }
-        Address entryAddress;
+        NodeId node;
         long heartbeat;
-        long timestamp;
 
         // read out single entry
-        memcpy(&entryAddress, (data+offset), sizeof(Address));
-        offset += sizeof(Address);
-        memcpy(&heartbeat, (data+offset), sizeof(long));
-        offset += sizeof(long);
-        
-        //final MemberListEntry entry(entryAddress.getid(),entryAddress.getport, heartbeat, timestamp);
-        updateMemberList(entryAddress, heartbeat);
-    }
+        Codec::decode(data+offset, node, heartbeat);
+        offset += entrySize;
 
+        updateMemberList(node, heartbeat);
+    }
+    return offset;
 }
 
-bool MP1Node::handleHeartbeatRequest(Member* member, char* data, int size) {
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleHeartbeatRequest(Member* member, char* data, int size) {
 
     #ifdef DEBUGLOG
       static char s[1024];
@@ -309,32 +470,355 @@ bool MP1Node::handleHeartbeatRequest(Member* member, char* data, int size) {
       sprintf(s, "received HEARTBEATREQ from %s",sourceAddress.getAddress().c_str());
       //log->LOG(&memberNode->addr, s);
     #endif
+    checkNeighbor((Address *)data);
     mergeMemberlist(member, data, size);
     return true;
 
 }
 
-bool MP1Node::handleJoinResponse(Member* member, char* data, int size) {
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleJoinResponse(Member* member, char* data, int size) {
     cout << "handle join response" << endl;
 
+    if (PeerSelector::PARTIAL_VIEW) {
+        Address introducer;
+        memcpy(&introducer.addr, data, sizeof(introducer.addr));
+        addNeighbor(NodeId(introducer), 0);
+    }
     mergeMemberlist(member, data, size);
     memberNode->inGroup = true;
     return true;
 }
 
-bool MP1Node::handleJoinRequest(Member* member, char* data, int size) {
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleJoinRequest(Member* member, char* data, int size) {
     cout << "handle join request, size " << size << endl;
     Address address;
     long heartbeat;
     memcpy(&address.addr, data, sizeof(Address));
     memcpy(&heartbeat, data + sizeof(address.addr), sizeof(long));
 
+    // listed and replied to in one batch at the end of this tick
+    pendingJoins.push_back(MemberListEntry(NodeId(address), heartbeat, par->getcurrtime()));
+
+ return true;
+}
+
+/**
+ * FUNCTION NAME: handleDigestRequest
+ *
+ * DESCRIPTION: Merge the sender's own entry, compare its digest with ours and answer with our entries
+ * 				of every range that differs. Nothing is sent if the views agree.
+ * 				Every node pulls from a random peer each tick, so there is no
+ * 				push back to the sender.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleDigestRequest(Member* member, char* data, int size) {
+    Address sourceAddress;
+    int ranges = 0;
+    memcpy(&sourceAddress.addr, data, sizeof(sourceAddress.addr));
+    checkNeighbor(&sourceAddress);
+    // the sender's own entry leads the digest
+    int offset = mergeMemberlist(member, data, size);
+    memcpy(&ranges, data + offset, sizeof(int));
+    offset += sizeof(int);
 
-    updateMemberList(address, heartbeat);
+    vector<unsigned short> digest;
+    computeDigest(digest);
 
-    sendWithMemberList(JOINREP,&address);
+    vector<int> differing;
+    for (int r = 0; r < par->DIGEST_RANGES; r++) {
+        unsigned short theirs = 0;
+        if (ranges == par->DIGEST_RANGES && size - offset >= (int)sizeof(unsigned short)) {
+            memcpy(&theirs, data + offset, sizeof(unsigned short));
+            offset += sizeof(unsigned short);
+        } else {
+            // unreadable digest, treat every range as different
+            theirs = ~digest[r];
+        }
+        if (theirs != digest[r]) {
+            differing.push_back(r);
+        }
+    }
+    if (differing.empty()) {
+        return true;
+    }
 
- return true;
+    vector<MemberListEntry> entries;
+    for(auto value: memberNode->memberList) {
+        if (find(differing.begin(), differing.end(), digestRange(value.getid())) != differing.end()) {
+            entries.push_back(value);
+        }
+    }
+    sendEntries(DIGESTREP, &sourceAddress, entries);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: handleDigestResponse
+ *
+ * DESCRIPTION: Merge the peer's entries of the ranges where our digests differed
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleDigestResponse(Member* member, char* data, int size) {
+    mergeMemberlist(member, data, size);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: handleDisseminate
+ *
+ * DESCRIPTION: Apply piggybacked membership news. Only news that changes our
+ * 				list goes back into our own dissemination buffer, so every
+ * 				change spreads like an infection and then dies out. Any
+ * 				message from a member we probed answers the probe.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleDisseminate(Member* member, char* data, int size) {
+    // Entry: codec entry + type(1 byte)
+    int entrySize = Codec::ENTRY_SIZE + sizeof(char);
+    int offset = sizeof(memberNode->addr.addr);
+    int count = 0;
+    checkNeighbor((Address *)data);
+    probes.erase(NodeId(*(Address *)data));
+    memcpy(&count, data + offset, sizeof(int));
+    offset += sizeof(int);
+
+    for (int i = 0; i < count && size - offset >= entrySize; i++) {
+        NodeId node;
+        long heartbeat;
+        char type;
+        Codec::decode(data + offset, node, heartbeat);
+        offset += Codec::ENTRY_SIZE;
+        type = data[offset];
+        offset += sizeof(char);
+
+        // refute suspicion of us with our current heartbeat, straight back to the
+        // suspecting sender and as news for whoever else suspects us
+        if (node == self) {
+            if (type == DISSEMINATE_SUSPECT || type == DISSEMINATE_DEAD) {
+                incarnation = ownHeartbeat();
+                disseminate(self, incarnation, DISSEMINATE_ALIVE);
+                sendDisseminate((Address *)data);
+            }
+            continue;
+        }
+        if (type == DISSEMINATE_LEFT) {
+            if (!isTombstoned(node, heartbeat)) {
+                leaveMember(node, heartbeat);
+            }
+            continue;
+        }
+        if (type == DISSEMINATE_JOIN || type == DISSEMINATE_ALIVE) {
+            // a newer heartbeat refutes a suspicion, and spreads as far as the suspicion did
+            bool suspected = isSuspected(node);
+            updateMemberList(node, heartbeat);
+            if (suspected && !isSuspected(node)) {
+                disseminate(node, heartbeat, DISSEMINATE_ALIVE);
+            }
+            continue;
+        }
+        vector<MemberListEntry>::iterator value = memberNode->memberList.begin();
+        while (value != memberNode->memberList.end() && value->getnode() != node) {
+            value++;
+        }
+        // newer heartbeats than the news overrule it
+        if (value == memberNode->memberList.end() || value->getheartbeat() > heartbeat) {
+            continue;
+        }
+        disseminate(node, heartbeat, (DisseminationType)type);
+        if (type == DISSEMINATE_DEAD) {
+            removeMember(value);
+        }
+        // no heartbeat of a probed member comes to clear it, so the suspicion is ours until refuted
+        else if (isProbed(node.getid()) && !isSuspected(node)) {
+            suspectMember(*value);
+        }
+    }
+    return true;
+}
+
+/**
+ * FUNCTION NAME: disseminate
+ *
+ * DESCRIPTION: Queue membership news for piggybacking. News about a member
+ * 				replaces older news about it; at the same heartbeat the
+ * 				graver kind wins.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::disseminate(NodeId node, long heartbeat, DisseminationType type) {
+    if (par->DISSEMINATION_MULT <= 0) {
+        return;
+    }
+    unordered_map<NodeId, DisseminationEntry>::iterator known = dissemination.find(node);
+    if (known != dissemination.end()
+        && (known->second.heartbeat > heartbeat
+            || (known->second.heartbeat == heartbeat && known->second.type >= type))) {
+        return;
+    }
+    DisseminationEntry entry;
+    entry.node = node;
+    entry.heartbeat = heartbeat;
+    entry.type = type;
+    entry.transmissions = retransmitLimit();
+    dissemination[node] = entry;
+}
+
+/**
+ * FUNCTION NAME: ownHeartbeat
+ *
+ * DESCRIPTION: Our own entry's heartbeat, 0 before we are listed
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+long MP1NodeT<PeerSelector, FailureDetector, Codec>::ownHeartbeat() {
+    for (auto value: memberNode->memberList) {
+        if (value.getnode() == self) {
+            return value.heartbeat;
+        }
+    }
+    return 0;
+}
+
+/**
+ * FUNCTION NAME: retransmitLimit
+ *
+ * DESCRIPTION: Probes that carry a piece of news, DISSEMINATION_MULT * log10(N + 1) rounded up
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::retransmitLimit() {
+    int limit = (int)ceil(par->DISSEMINATION_MULT * log10(memberNode->memberList.size() + 1.0));
+    return max(limit, 1);
+}
+
+/**
+ * FUNCTION NAME: sendDisseminate
+ *
+ * DESCRIPTION: Send our own entry plus the least retransmitted news that fits
+ * 				in DISSEMINATION_BYTES, as a probe (DISSEMINATE) or as the
+ * 				answer to one (DISSEMINATEACK). News is retired once it has
+ * 				gone out on retransmitLimit() probes; answers carry it for
+ * 				free and a refused send does not count.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::sendDisseminate(Address* targetAddress, MsgTypes msgType) {
+    size_t entrySize = Codec::ENTRY_SIZE + sizeof(char);
+    size_t headerSize = sizeof(MessageHdr) + sizeof(memberNode->addr.addr) + sizeof(int);
+
+    vector<DisseminationEntry*> news;
+    for (auto &item: dissemination) {
+        news.push_back(&item.second);
+    }
+    // news about the receiver goes first, so a suspect always hears of it and can refute it,
+    // then departures, then the least retransmitted news
+    NodeId target(*targetAddress);
+    sort(news.begin(), news.end(), [&](DisseminationEntry* a, DisseminationEntry* b) {
+        if ((a->node == target) != (b->node == target)) {
+            return a->node == target;
+        }
+        if ((a->type == DISSEMINATE_LEFT) != (b->type == DISSEMINATE_LEFT)) {
+            return a->type == DISSEMINATE_LEFT;
+        }
+        return a->transmissions > b->transmissions;
+    });
+    int room = ((int)par->DISSEMINATION_BYTES - (int)headerSize) / (int)entrySize - 1;
+    news.resize(max(0, min(room, (int)news.size())));
+    // probing members only hear of our heartbeat when it refutes a suspicion,
+    // so all of them list the same one and agree on what news is stale
+    long heartbeat = incarnation;
+
+    int count = 1 + news.size();
+    size_t size = headerSize + entrySize * count;
+    char* msg = (char*) malloc(size);
+    int offset = 0;
+    memcpy(msg, &msgType, sizeof(MsgTypes));
+    offset += sizeof(MsgTypes);
+    memcpy((msg+offset), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    offset += sizeof(memberNode->addr.addr);
+    memcpy((msg+offset), &count, sizeof(int));
+    offset += sizeof(int);
+    Codec::encode(msg+offset, self, heartbeat);
+    offset += Codec::ENTRY_SIZE;
+    msg[offset++] = DISSEMINATE_ALIVE;
+    for (auto entry: news) {
+        Codec::encode(msg+offset, entry->node, entry->heartbeat);
+        offset += Codec::ENTRY_SIZE;
+        msg[offset++] = (char)entry->type;
+    }
+    int sent = emulNet->ENsend(&memberNode->addr, targetAddress, msg, size);
+    free(msg);
+    if (sent == EN_BACKPRESSURE) {
+        return false;
+    }
+
+    if (msgType == DISSEMINATEACK) {
+        return true;
+    }
+    for (auto entry: news) {
+        if (--entry->transmissions <= 0) {
+            dissemination.erase(entry->node);
+        }
+    }
+    return true;
+}
+
+/**
+ * FUNCTION NAME: isProbed
+ *
+ * DESCRIPTION: Check if we learn that a member is alive by probing it rather
+ * 				than from its heartbeats, as for every member we send news to
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::isProbed(int id) {
+    return par->DISSEMINATION_MULT > 0 && isInMyZone(id);
+}
+
+/**
+ * FUNCTION NAME: isSuspected
+ *
+ * DESCRIPTION: Check if a member is on the kicklist
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::isSuspected(NodeId node) {
+    return std::any_of(kicklist.begin(), kicklist.end(), [&](MemberListEntry& kicked) {
+        return kicked.getnode() == node;
+    });
+}
+
+/**
+ * FUNCTION NAME: checkProbes
+ *
+ * DESCRIPTION: Probe again every member that let a round trip pass without
+ * 				answering, and suspect it once TFAIL ticks passed since the
+ * 				first probe. A suspect is not probed any more: the suspicion
+ * 				reaches it as news, and its refutation answers for it.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::checkProbes() {
+    long now = par->getcurrtime();
+    for (auto probe = probes.begin(); probe != probes.end();) {
+        vector<MemberListEntry>::iterator value = memberNode->memberList.begin();
+        while (value != memberNode->memberList.end() && value->getnode() != probe->first) {
+            value++;
+        }
+        if (value == memberNode->memberList.end()) {
+            probe = probes.erase(probe);
+            continue;
+        }
+        if (isSuspected(probe->first)) {
+            probe = probes.erase(probe);
+            continue;
+        }
+        if (now - probe->second > TFAIL) {
+            suspectMember(*value);
+            probe = probes.erase(probe);
+            continue;
+        }
+        if (now - probe->second >= 2) {
+            Address address = probe->first.toAddress();
+            sendDisseminate(&address);
+        }
+        probe++;
+    }
 }
 
 /**
@@ -342,7 +826,8 @@ bool MP1Node::handleJoinRequest(Member* member, char* data, int size) {
  *
  * DESCRIPTION: Message handler for different message types
  */
-bool MP1Node::recvCallBack(void *env, char *data, int size ) {
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::recvCallBack(void *env, char *data, int size ) {
 	/*
 	 * Your code goes here
 	 */
@@ -362,6 +847,41 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
         case HEARTBEATREQ:
             result = handleHeartbeatRequest((Member*)env,data + offset, size - offset);
             break;
+        case DIGESTREQ:
+            result = handleDigestRequest((Member*)env,data + offset, size - offset);
+            break;
+        case DIGESTREP:
+            result = handleDigestResponse((Member*)env,data + offset, size - offset);
+            break;
+        case DISSEMINATE:
+            result = handleDisseminate((Member*)env,data + offset, size - offset);
+            // a DISSEMINATE probes us, the answer carries our entry and news back
+            sendDisseminate((Address *)(data + offset), DISSEMINATEACK);
+            break;
+        case DISSEMINATEACK:
+            result = handleDisseminate((Member*)env,data + offset, size - offset);
+            break;
+        case NEIGHBORREQ:
+            result = handleNeighborRequest((Member*)env,data + offset, size - offset);
+            break;
+        case DISCONNECT:
+            result = handleDisconnect((Member*)env,data + offset, size - offset);
+            break;
+        case SHUFFLEREQ:
+            result = handleShuffleRequest((Member*)env,data + offset, size - offset);
+            break;
+        case SHUFFLEREP:
+            result = handleShuffleResponse((Member*)env,data + offset, size - offset);
+            break;
+        case LEAVE:
+            result = handleLeave((Member*)env,data + offset, size - offset);
+            break;
+        case APPDATA:
+            // application traffic sharing the network, nothing for the protocol
+            result = true;
+            break;
+        default:
+            break;
     }
 
 
@@ -378,7 +898,8 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
  * 				the nodes
  * 				Propagate your membership list
  */
-void MP1Node::nodeLoopOps() {
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::nodeLoopOps() {
 
 	/*
 	 * Your code goes here
@@ -389,31 +910,33 @@ void MP1Node::nodeLoopOps() {
     }
     // increase own heartbeat
     for (std::vector<MemberListEntry>::iterator value=memberNode->memberList.begin();value < memberNode->memberList.end(); value++) {
-      Address address2 = buildAddress(value->getid(),value->getport());
-      if (memberNode->addr == address2){
+      if (value->getnode() == self){
         value->setheartbeat(value->getheartbeat()+1);
         cout << "increased own heartbeat " << value->getheartbeat() << endl;
       }
     }
 
-    //for (int i = 0; i < (memberNode->memberList.size() / 2) ;i++) {
-        int randomIndex = rand() % memberNode->memberList.size();
-        MemberListEntry entry = memberNode->memberList[randomIndex];
-        Address address = buildAddress(entry.id, entry.port);
-        if (memberNode->addr == address) {
-          return;
-        }
+    retryDeferredGossip();
+    if (PeerSelector::PARTIAL_VIEW) {
+        maintainViews();
+    }
+
+    vector<NodeId> targets;
+    selector.select(memberNode->memberList, self, targets);
+    for (auto target: targets) {
+        Address address = target.toAddress();
         cout << "me: " << memberNode->addr.getAddress()
                 << ", gossip to" << address.getAddress()
                 << endl;
-                sendWithMemberList(HEARTBEATREQ,&address);
-    //}
+        gossipOrDefer(&address);
+    }
     cleanupMembers();
 
     return;
 }
 
-void MP1Node::cleanupMembers() {
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::cleanupMembers() {
 
     #ifdef DEBUGLOG
         static char s[1024];
@@ -431,42 +954,85 @@ void MP1Node::cleanupMembers() {
       }
     #endif
 
+    // forget removed members once their gossip can no longer be in flight
+    for (std::vector<MemberListEntry>::iterator value=tombstones.begin();value < tombstones.end();) {
+      if ((par->getcurrtime() - value->gettimestamp()) > TTOMBSTONE) {
+        value = tombstones.erase(value);
+      } else {
+        value++;
+      }
+    }
+
+    if (par->DISSEMINATION_MULT > 0) {
+        checkProbes();
+    }
+
+    // removing a member also drops it from kicklist, so pick the expired ones first.
+    // A probed member's kicklist entry is stamped when it was suspected, and it
+    // goes after the TREMOVE - TFAIL ticks a heartbeat timeout leaves it.
+    vector<MemberListEntry> expired;
     for (auto entry: kicklist) {
+        if (isProbed(entry.getid()) ? par->getcurrtime() - entry.gettimestamp() > TREMOVE - TFAIL
+                                    : detector.isExpired(entry, par->getcurrtime())) {
+          expired.push_back(entry);
+        }
+    }
+
+    for (auto entry: expired) {
         
         long delay = (par->getcurrtime() - entry.gettimestamp());
-        if(delay > TREMOVE) {
           for (std::vector<MemberListEntry>::iterator value=memberNode->memberList.begin();value < memberNode->memberList.end(); value++) {
         
-            if (value->getid() == entry.getid() && value->getport() == entry.getport()) {
-              Address address = buildAddress(entry.id, entry.port);
-              memberNode->memberList.erase(value);
-              log->logNodeRemove(&memberNode->addr, &address);
+            if (value->peer == entry.peer) {
+              maxRemovalDelay = max(maxRemovalDelay, delay);
+              disseminate(entry.getnode(), value->getheartbeat(), DISSEMINATE_DEAD);
+              removeMember(value);
               #ifdef DEBUGLOG
-                sprintf(s,"removed %s", address.getAddress().c_str());
+                sprintf(s,"removed %s", entry.getnode().getAddress().c_str());
                 //log->LOG(&memberNode->addr, s);
               #endif
-              cout << "removed node " << address.getAddress() << "("<< delay  << ")" << endl;
+              cout << "removed node " << entry.getnode().getAddress() << "("<< delay  << ")" << endl;
+              break;
             }
           }
-        }
 
     }
 
-    kicklist.clear();
+    if (par->INCREMENTAL_SWEEP) {
+      sweepMembers();
+      return;
+    }
+
+    vector<MemberListEntry> previous;
+    previous.swap(kicklist);
+    // probed members stay suspected until they refute it or expire
+    for (auto kicked: previous) {
+      if (isProbed(kicked.getid())) {
+        kicklist.push_back(kicked);
+      }
+    }
+
+    sweepExamined += memberNode->memberList.size();
+    sweepMaxSlice = max(sweepMaxSlice, (int)memberNode->memberList.size());
+    sweepMaxRound = 1;
 
     std::for_each(memberNode->memberList.begin(),memberNode->memberList.end(),
     [&](MemberListEntry& entry){
 
-      Address address = buildAddress(entry.id, entry.port);
-      // skip myself
-      if (
-        memberNode->addr == address
-      ) {
+      // skip myself, and the members we probe
+      if (entry.getnode() == self || isProbed(entry.getid())) {
         return;
       }
 
-      if((par->getcurrtime() - entry.gettimestamp()) > TFAIL) {  
-       kicklist.push_back(entry);
+      if(detector.isSuspect(entry, par->getcurrtime())) {
+       bool alreadySuspected = std::any_of(previous.begin(), previous.end(), [&](MemberListEntry& kicked) {
+         return kicked.peer == entry.peer;
+       });
+       if (alreadySuspected) {
+         kicklist.push_back(entry);
+       } else {
+         suspectMember(entry);
+       }
       }
     }); 
 
@@ -474,92 +1040,1109 @@ void MP1Node::cleanupMembers() {
 
 }
 
-bool MP1Node::sendWithMemberList(MsgTypes msgType, Address* targetAddress) {
-
+/**
+ * FUNCTION NAME: sweepMembers
+ *
+ * DESCRIPTION: Check the next slice of the member list for suspects. The slice is
+ * 				sized so that a round over the whole list takes at most TFAIL
+ * 				ticks, about N/TFAIL entries per tick. Suspicion lags the full
+ * 				scan: two checks of a member can be 2*TFAIL - 1 ticks apart, so
+ * 				one that turns suspect just after a check is suspected up to
+ * 				2*TFAIL - 1 ticks late, up to 3*TFAIL ticks after its last
+ * 				refresh. Only the removal bound is kept: that is still before
+ * 				TREMOVE, and a suspect expires TREMOVE ticks after its refresh.
+ * 				kicklist persists across ticks: refreshed members leave it in
+ * 				updateMemberList, removed ones in unlinkMember.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::sweepMembers() {
+    vector<MemberListEntry>& list = memberNode->memberList;
+    long now = par->getcurrtime();
+    if (sweepCursor == 0) {
+      sweepRoundStart = now;
+    }
 
-    // Entry: Address(6 byte) + heartbeat(8 byte) 
-    size_t entrySize = sizeof(memberNode->addr.addr) + sizeof(long);
-    // total size: Entry size(14 byte) * count memberlist
-    int memberlistCount = memberNode->memberList.size();
-    size_t totalSize = entrySize * memberlistCount;
-    // MessageHdr(4 byte) + Address(6 byte) + Memberlist Size(4 byte) + memberlist size (Entry size 14 byte * count memberlist)
-    size_t size = sizeof(MessageHdr) + sizeof(memberNode->addr.addr) +  sizeof(int) +  totalSize;
-    char* msg = (char*) malloc(size);
-    int offset2 = 0;
-    memcpy(msg, &msgType, sizeof(MsgTypes));
-    offset2 += sizeof(MsgTypes);
-    memcpy((char *)(msg+offset2), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
-    offset2 += sizeof(memberNode->addr.addr);
-    memcpy((char *)(msg+offset2), &memberlistCount, sizeof(int));
-    offset2 += sizeof(int);
-    for(auto value: memberNode->memberList) {
-        Address address = buildAddress(value.id, value.port);
-        memcpy((msg+offset2), &address.addr, sizeof(address.addr));
-        offset2 += sizeof(address.addr);
-        memcpy((msg+offset2), &value.heartbeat, sizeof(long));
-        offset2 += sizeof(long);
+    // spread what is left of the round over the ticks it has left
+    long ticksLeft = max(1L, TFAIL - (now - sweepRoundStart));
+    int left = (int)list.size() - sweepCursor;
+    int slice = (int)((left + ticksLeft - 1) / ticksLeft);
+    sweepExamined += slice;
+    sweepMaxSlice = max(sweepMaxSlice, slice);
+
+    for (int end = sweepCursor + slice; sweepCursor < end; sweepCursor++) {
+      MemberListEntry& entry = list[sweepCursor];
+      if (entry.getnode() == self || isProbed(entry.getid())) {
+        continue;
+      }
+      if (!detector.isSuspect(entry, now)) {
+        continue;
+      }
+      bool alreadySuspected = std::any_of(kicklist.begin(), kicklist.end(), [&](MemberListEntry& kicked) {
+        return kicked.peer == entry.peer;
+      });
+      if (!alreadySuspected) {
+        suspectMember(entry);
+      }
     }
-    cout << "size - offset2 " << (size-offset2) << endl;
-    emulNet->ENsend(&memberNode->addr, targetAddress, (char *)msg, size);
-    cout << "try to free msg " << sizeof(msg) << endl;
-    free(msg);
-    cout << "done" << endl;
-    msg=NULL;
 
-    return true;
+    if (sweepCursor >= (int)list.size()) {
+      sweepMaxRound = max(sweepMaxRound, now - sweepRoundStart + 1);
+      // the suspicion lag above only holds while rounds fit in TFAIL ticks
+      assert(sweepMaxRound <= TFAIL);
+      sweepCursor = 0;
+    }
 }
 
-Address MP1Node::buildAddress(int id, short port) {
-    return Address(to_string(id)+":"+to_string(port));
+/**
+ * FUNCTION NAME: suspectMember
+ *
+ * DESCRIPTION: Put a member on the kicklist and tell listeners and peers
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::suspectMember(MemberListEntry& entry) {
+    MemberListEntry suspect = entry;
+    // a probed member's suspicion runs from now, its timestamp is as old as its heartbeat
+    if (isProbed(entry.getid())) {
+        suspect.settimestamp(par->getcurrtime());
+    } else {
+        maxSuspectDelay = max(maxSuspectDelay, par->getcurrtime() - entry.gettimestamp());
+    }
+    kicklist.push_back(suspect);
+    notifyListeners(MEMBER_SUSPECTED, entry.getnode(), entry.heartbeat);
+    disseminate(entry.getnode(), entry.heartbeat, DISSEMINATE_SUSPECT);
 }
 
 /**
- * FUNCTION NAME: isNullAddress
+ * FUNCTION NAME: removeMember
  *
- * DESCRIPTION: Function checks if the address is NULL
+ * DESCRIPTION: Drop a member from the list and keep a tombstone so stale gossip cannot re-add it
  */
-int MP1Node::isNullAddress(Address *addr) {
-	return (memcmp(addr->addr, NULLADDR, 6) == 0 ? 1 : 0);
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::removeMember(vector<MemberListEntry>::iterator value) {
+    NodeId node = value->getnode();
+    long heartbeat = value->getheartbeat();
+    tombstones.push_back(MemberListEntry(node, heartbeat, par->getcurrtime()));
+    notifyListeners(MEMBER_REMOVED, node, heartbeat);
+    detector.forget(node);
+    unlinkMember(value);
+    log->logNodeRemove(&memberNode->addr, node);
 }
 
 /**
- * FUNCTION NAME: getJoinAddress
+ * FUNCTION NAME: unlinkMember
  *
- * DESCRIPTION: Returns the Address of the coordinator
+ * DESCRIPTION: Erase a member list entry, keeping kicklist and the sweep cursor in step
  */
-Address MP1Node::getJoinAddress() {
-    Address joinaddr;
-
-    memset(&joinaddr, 0, sizeof(Address));
-    *(int *)(&joinaddr.addr) = 1;
-    *(short *)(&joinaddr.addr[4]) = 0;
-
-    return joinaddr;
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::unlinkMember(vector<MemberListEntry>::iterator value) {
+    int peer = value->peer;
+    probes.erase(value->getnode());
+    if (value - memberNode->memberList.begin() < sweepCursor) {
+      sweepCursor--;
+    }
+    memberNode->memberList.erase(value);
+    for (std::vector<MemberListEntry>::iterator kicked=kicklist.begin();kicked < kicklist.end(); kicked++) {
+      if (kicked->peer == peer) {
+        kicklist.erase(kicked);
+        break;
+      }
+    }
 }
 
 /**
- * FUNCTION NAME: initMemberListTable
+ * FUNCTION NAME: handleLeave
  *
- * DESCRIPTION: Initialize the membership list
+ * DESCRIPTION: A member left the group. Drop it at once and relay the LEAVE
+ * 				the first time we hear of it, so the news floods the group
+ * 				within a few ticks. The tombstone stops both stale gossip and
+ * 				further relaying.
  */
-void MP1Node::initMemberListTable(Member *memberNode) {
-	memberNode->memberList.clear();
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleLeave(Member* member, char* data, int size) {
+    int offset = sizeof(memberNode->addr.addr);
+    int count = 0;
+    memcpy(&count, data + offset, sizeof(int));
+    offset += sizeof(int);
 
-	int id = *(int*)(&memberNode->addr.addr);
-	int port = *(short*)(&memberNode->addr.addr[4]);
+    for (int i = 0; i < count && size - offset >= Codec::ENTRY_SIZE; i++) {
+        NodeId node;
+        long heartbeat;
+        Codec::decode(data + offset, node, heartbeat);
+        offset += Codec::ENTRY_SIZE;
+        if (node == self || isTombstoned(node, heartbeat)) {
+            continue;
+        }
+        leaveMember(node, heartbeat);
+        sendLeave(node, heartbeat);
+    }
+    return true;
+}
 
-    MemberListEntry entry(id,port, 0, par->getcurrtime());
-    memberNode->memberList.push_back(entry);
-    memberNode->myPos = memberNode->memberList.begin();
+/**
+ * FUNCTION NAME: leaveMember
+ *
+ * DESCRIPTION: Forget a member that left, tombstoned even if we did not list it
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::leaveMember(NodeId node, long heartbeat) {
+    bool listed = false;
+    for (std::vector<MemberListEntry>::iterator value=memberNode->memberList.begin();value < memberNode->memberList.end(); value++) {
+        if (value->getnode() == node) {
+            removeMember(value);
+            listed = true;
+            break;
+        }
+    }
+    if (!listed) {
+        tombstones.push_back(MemberListEntry(node, heartbeat, par->getcurrtime()));
+    }
+    passiveView.erase(std::remove(passiveView.begin(), passiveView.end(), node), passiveView.end());
+    for (std::vector<MemberListEntry>::iterator value=neighborRequests.begin();value < neighborRequests.end(); value++) {
+        if (value->getnode() == node) {
+            neighborRequests.erase(value);
+            break;
+        }
+    }
+    disseminate(node, heartbeat, DISSEMINATE_LEFT);
 }
 
 /**
- * FUNCTION NAME: printAddress
+ * FUNCTION NAME: sendLeave
  *
- * DESCRIPTION: Print the Address
+ * DESCRIPTION: Send a LEAVE for a member to LEAVE_FANOUT random members
  */
-void MP1Node::printAddress(Address *addr)
-{
-    printf("%d.%d.%d.%d:%d \n",  addr->addr[0],addr->addr[1],addr->addr[2],
-                                                       addr->addr[3], *(short*)&addr->addr[4]) ;
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::sendLeave(NodeId node, long heartbeat) {
+    vector<MemberListEntry> leaver(1, MemberListEntry(node, heartbeat, par->getcurrtime()));
+    vector<int> others;
+    for (int i = 0; i < (int)memberNode->memberList.size(); i++) {
+        NodeId other = memberNode->memberList[i].getnode();
+        if (other != self && other != node) {
+            others.push_back(i);
+        }
+    }
+    for (int i = 0; i < (int)others.size() && i < par->LEAVE_FANOUT; i++) {
+        int j = i + rand() % (others.size() - i);
+        swap(others[i], others[j]);
+        Address address = memberNode->memberList[others[i]].getnode().toAddress();
+        sendEntries(LEAVE, &address, leaver);
+    }
+}
+
+/**
+ * FUNCTION NAME: isTombstoned
+ *
+ * DESCRIPTION: Check if a heartbeat of a member we removed recently is stale.
+ * 				Peers may still gossip heartbeats of a dead member we never
+ * 				heard, but not TREMOVE more of them, or we would not have
+ * 				timed it out. Anything newer comes from a new life.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::isTombstoned(NodeId node, long heartbeat) {
+    for (auto tombstone: tombstones) {
+        if (tombstone.getnode() == node && tombstone.getheartbeat() + TREMOVE >= heartbeat) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * FUNCTION NAME: resumeHeartbeat
+ *
+ * DESCRIPTION: Heartbeat a joiner starts from. A node that restarts counts from
+ * 				0 again, so if we still list or tombstone its previous life it
+ * 				resumes far enough above the last heartbeat we heard of it to
+ * 				clear the tombstones and stale entries the others keep of it.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+long MP1NodeT<PeerSelector, FailureDetector, Codec>::resumeHeartbeat(NodeId node, long heartbeat) {
+    long known = -1;
+    bool removed = false;
+    for (auto value: memberNode->memberList) {
+        if (value.getnode() == node) {
+            known = value.getheartbeat();
+        }
+    }
+    for (auto tombstone: tombstones) {
+        if (tombstone.getnode() == node) {
+            known = max(known, tombstone.getheartbeat());
+            removed = true;
+        }
+    }
+    // a JOINREQ sent again is no restart
+    if (known <= heartbeat && !removed) {
+        return heartbeat;
+    }
+    return known + TTOMBSTONE + 1;
+}
+
+/**
+ * FUNCTION NAME: isInMyZone
+ *
+ * DESCRIPTION: Check if a member shares this node's zone, as the peer selector
+ * 				lays zones out. Always true for flat gossip and partial views.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::isInMyZone(int id) {
+    return selector.zoneOf(id) == selector.zoneOf(self.getid());
+}
+
+/**
+ * FUNCTION NAME: admitForeignMember
+ *
+ * DESCRIPTION: Only the ZONE_REPS lowest ids of a foreign zone are kept as its
+ * 				representatives, so every node agrees on who they are.
+ * 				Evicts a higher representative if the new member displaces it.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::admitForeignMember(int id) {
+    int zone = selector.zoneOf(id);
+    int lower = 0;
+    vector<MemberListEntry>::iterator highest = memberNode->memberList.end();
+    int known = 0;
+    for (std::vector<MemberListEntry>::iterator value=memberNode->memberList.begin();value < memberNode->memberList.end(); value++) {
+        if (selector.zoneOf(value->getid()) != zone) {
+            continue;
+        }
+        known++;
+        if (value->getid() < id) {
+            lower++;
+        }
+        if (highest == memberNode->memberList.end() || value->getid() > highest->getid()) {
+            highest = value;
+        }
+    }
+    if (lower >= par->ZONE_REPS) {
+        return false;
+    }
+    // the displaced representative is removed like any other member, so its
+    // removal is logged and the tombstone keeps stale gossip from re-adding it
+    if (known >= par->ZONE_REPS) {
+        removeMember(highest);
+    }
+    return true;
+}
+
+/**
+ * FUNCTION NAME: neighborCount
+ *
+ * DESCRIPTION: Members of the active view besides this node
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::neighborCount() {
+    return max(0, (int)memberNode->memberList.size() - 1);
+}
+
+/**
+ * FUNCTION NAME: isNeighbor
+ *
+ * DESCRIPTION: Check if a node is in the active view
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::isNeighbor(NodeId node) {
+    return std::any_of(memberNode->memberList.begin(), memberNode->memberList.end(), [&](MemberListEntry& entry) {
+        return entry.getnode() == node;
+    });
+}
+
+/**
+ * FUNCTION NAME: addNeighbor
+ *
+ * DESCRIPTION: Take a node into the active view, making room by demoting a
+ * 				random neighbor if the view is full. Direct contact proves the
+ * 				node alive, so a tombstone does not keep it out.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::addNeighbor(NodeId node, long heartbeat) {
+    if (node == self || isNeighbor(node)) {
+        return;
+    }
+    passiveView.erase(std::remove(passiveView.begin(), passiveView.end(), node), passiveView.end());
+    for (std::vector<MemberListEntry>::iterator value=neighborRequests.begin();value < neighborRequests.end(); value++) {
+        if (value->getnode() == node) {
+            neighborRequests.erase(value);
+            break;
+        }
+    }
+    if (neighborCount() >= par->VIEW_SIZE) {
+        vector<MemberListEntry>::iterator victim = memberNode->memberList.begin() + rand() % memberNode->memberList.size();
+        if (victim->getnode() == self) {
+            victim = memberNode->memberList.begin() + (victim - memberNode->memberList.begin() + 1) % memberNode->memberList.size();
+        }
+        demoteNeighbor(victim);
+    }
+    addMember(node, heartbeat);
+}
+
+/**
+ * FUNCTION NAME: demoteNeighbor
+ *
+ * DESCRIPTION: Move a neighbor to the passive view and tell it to do the same with us
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::demoteNeighbor(vector<MemberListEntry>::iterator value) {
+    NodeId node = value->getnode();
+    Address address = node.toAddress();
+    sendViewMessage(DISCONNECT, &address, 0);
+    notifyListeners(MEMBER_DEMOTED, node, value->getheartbeat());
+    detector.forget(node);
+    unlinkMember(value);
+    addPassive(node);
+}
+
+/**
+ * FUNCTION NAME: checkNeighbor
+ *
+ * DESCRIPTION: Links of the active view are symmetric. Gossip from a node we
+ * 				asked to become a neighbor accepts the request; gossip from
+ * 				any other node outside the view is answered with DISCONNECT,
+ * 				so it drops us as well.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::checkNeighbor(Address* sourceAddress) {
+    if (!PeerSelector::PARTIAL_VIEW) {
+        return;
+    }
+    NodeId sender(*sourceAddress);
+    if (sender == self || isNeighbor(sender)) {
+        return;
+    }
+    bool requested = std::any_of(neighborRequests.begin(), neighborRequests.end(), [&](MemberListEntry& request) {
+        return request.getnode() == sender;
+    });
+    if (requested) {
+        addNeighbor(sender, 0);
+        return;
+    }
+    sendViewMessage(DISCONNECT, sourceAddress, 0);
+}
+
+/**
+ * FUNCTION NAME: addPassive
+ *
+ * DESCRIPTION: Remember a peer outside the active view, replacing a random
+ * 				one once PASSIVE_VIEW_SIZE peers are known
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::addPassive(NodeId node) {
+    if (node == self || par->PASSIVE_VIEW_SIZE <= 0 || isTombstoned(node) || isNeighbor(node)) {
+        return;
+    }
+    if (find(passiveView.begin(), passiveView.end(), node) != passiveView.end()) {
+        return;
+    }
+    for (auto request: neighborRequests) {
+        if (request.getnode() == node) {
+            return;
+        }
+    }
+    if ((int)passiveView.size() >= par->PASSIVE_VIEW_SIZE) {
+        passiveView[rand() % passiveView.size()] = node;
+        return;
+    }
+    passiveView.push_back(node);
+}
+
+/**
+ * FUNCTION NAME: maintainViews
+ *
+ * DESCRIPTION: Fill free active view slots with passive peers, and shuffle
+ * 				part of the passive view with a neighbor every SHUFFLE_PERIOD
+ * 				ticks. A request counts as urgent while fewer than half of the
+ * 				slots are taken, the peer then makes room for us.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::maintainViews() {
+    long now = par->getcurrtime();
+
+    // unanswered requests: the peer is gone
+    for (std::vector<MemberListEntry>::iterator value=neighborRequests.begin();value < neighborRequests.end();) {
+        if (now - value->gettimestamp() > TFAIL) {
+            value = neighborRequests.erase(value);
+        } else {
+            value++;
+        }
+    }
+
+    char urgent = neighborCount() < max(1, par->VIEW_SIZE / 2);
+    int open = par->VIEW_SIZE - neighborCount() - (int)neighborRequests.size();
+    while (open-- > 0 && !passiveView.empty()) {
+        int i = rand() % passiveView.size();
+        NodeId node = passiveView[i];
+        Address address = node.toAddress();
+        if (!sendViewMessage(NEIGHBORREQ, &address, urgent)) {
+            break;
+        }
+        passiveView.erase(passiveView.begin() + i);
+        neighborRequests.push_back(MemberListEntry(node, 0, now));
+    }
+
+    if (neighborCount() == 0 || par->SHUFFLE_PERIOD <= 0 || (now + self.getid()) % par->SHUFFLE_PERIOD != 0) {
+        return;
+    }
+    vector<MemberListEntry> entries;
+    for (auto value: memberNode->memberList) {
+        if (value.getnode() == self) {
+            entries.push_back(value);
+        }
+    }
+    sampleEntries(entries, par->SHUFFLE_LENGTH);
+    MemberListEntry& peer = memberNode->memberList[rand() % memberNode->memberList.size()];
+    if (peer.getnode() == self) {
+        return;
+    }
+    Address address = peer.getnode().toAddress();
+    sendEntries(SHUFFLEREQ, &address, entries);
+}
+
+/**
+ * FUNCTION NAME: sampleEntries
+ *
+ * DESCRIPTION: Add random peers of the passive and active views until entries
+ * 				holds count of them. Passive peers carry no heartbeat.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::sampleEntries(vector<MemberListEntry>& entries, int count) {
+    vector<MemberListEntry> candidates;
+    for (auto node: passiveView) {
+        candidates.push_back(MemberListEntry(node, 0, par->getcurrtime()));
+    }
+    for (auto value: memberNode->memberList) {
+        if (value.getnode() != self) {
+            candidates.push_back(value);
+        }
+    }
+    for (int i = 0; i < (int)candidates.size() && (int)entries.size() < count; i++) {
+        int j = i + rand() % (candidates.size() - i);
+        swap(candidates[i], candidates[j]);
+        entries.push_back(candidates[i]);
+    }
+}
+
+/**
+ * FUNCTION NAME: sendViewMessage
+ *
+ * DESCRIPTION: Send a NEIGHBORREQ or DISCONNECT: our address and a flag byte,
+ * 				the urgency of a neighbor request.
+ * 				Returns false if EmulNet refused the message with backpressure.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::sendViewMessage(MsgTypes msgType, Address* targetAddress, char flag) {
+    size_t size = sizeof(MessageHdr) + sizeof(memberNode->addr.addr) + sizeof(char);
+    char* msg = (char*) malloc(size);
+    int offset = 0;
+    memcpy(msg, &msgType, sizeof(MsgTypes));
+    offset += sizeof(MsgTypes);
+    memcpy((msg+offset), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    offset += sizeof(memberNode->addr.addr);
+    msg[offset] = flag;
+    int sent = emulNet->ENsend(&memberNode->addr, targetAddress, msg, size);
+    free(msg);
+    return sent != EN_BACKPRESSURE;
+}
+
+/**
+ * FUNCTION NAME: handleNeighborRequest
+ *
+ * DESCRIPTION: Accept a peer into the active view if there is room or the
+ * 				request is urgent, by gossiping to it from the next tick on.
+ * 				Refuse it with DISCONNECT otherwise.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleNeighborRequest(Member* member, char* data, int size) {
+    Address sourceAddress;
+    memcpy(&sourceAddress.addr, data, sizeof(sourceAddress.addr));
+    char urgent = data[sizeof(sourceAddress.addr)];
+    if (!PeerSelector::PARTIAL_VIEW || isNeighbor(NodeId(sourceAddress))) {
+        return true;
+    }
+    if (neighborCount() < par->VIEW_SIZE || urgent) {
+        addNeighbor(NodeId(sourceAddress), 0);
+    } else {
+        sendViewMessage(DISCONNECT, &sourceAddress, 0);
+    }
+    return true;
+}
+
+/**
+ * FUNCTION NAME: handleDisconnect
+ *
+ * DESCRIPTION: The peer dropped us from its active view or refused our request,
+ * 				keep it as a passive peer
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleDisconnect(Member* member, char* data, int size) {
+    Address sourceAddress;
+    memcpy(&sourceAddress.addr, data, sizeof(sourceAddress.addr));
+    NodeId node(sourceAddress);
+    for (std::vector<MemberListEntry>::iterator value=neighborRequests.begin();value < neighborRequests.end(); value++) {
+        if (value->getnode() == node) {
+            neighborRequests.erase(value);
+            break;
+        }
+    }
+    for (std::vector<MemberListEntry>::iterator value=memberNode->memberList.begin();value < memberNode->memberList.end(); value++) {
+        if (value->getnode() == node) {
+            notifyListeners(MEMBER_DEMOTED, node, value->getheartbeat());
+            detector.forget(node);
+            unlinkMember(value);
+            break;
+        }
+    }
+    addPassive(node);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: handleShuffleRequest
+ *
+ * DESCRIPTION: Answer a shuffle with as many of our own peers, then keep the
+ * 				ones we were sent
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleShuffleRequest(Member* member, char* data, int size) {
+    Address sourceAddress;
+    int count = 0;
+    memcpy(&sourceAddress.addr, data, sizeof(sourceAddress.addr));
+    memcpy(&count, data + sizeof(sourceAddress.addr), sizeof(int));
+
+    vector<MemberListEntry> entries;
+    sampleEntries(entries, count);
+    sendEntries(SHUFFLEREP, &sourceAddress, entries);
+    mergeMemberlist(member, data, size);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: handleShuffleResponse
+ *
+ * DESCRIPTION: Keep the peers a shuffle brought back
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::handleShuffleResponse(Member* member, char* data, int size) {
+    mergeMemberlist(member, data, size);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: samplePeer
+ *
+ * DESCRIPTION: A peer drawn uniformly from everybody this node knows of,
+ * 				both views with partial views. Returns false if it knows nobody.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::samplePeer(Address *peer) {
+    int known = neighborCount() + passiveView.size();
+    if (known == 0) {
+        return false;
+    }
+    int pick = rand() % known;
+    if (pick < (int)passiveView.size()) {
+        *peer = passiveView[pick].toAddress();
+        return true;
+    }
+    pick -= passiveView.size();
+    for (auto value: memberNode->memberList) {
+        if (value.getnode() == self) {
+            continue;
+        }
+        if (pick-- == 0) {
+            *peer = value.getnode().toAddress();
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * FUNCTION NAME: addListener
+ *
+ * DESCRIPTION: Subscribe to this node's membership changes
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::addListener(MembershipListener *listener) {
+    listeners.push_back(listener);
+}
+
+/**
+ * FUNCTION NAME: removeListener
+ *
+ * DESCRIPTION: Unsubscribe from this node's membership changes
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::removeListener(MembershipListener *listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+/**
+ * FUNCTION NAME: notifyListeners
+ *
+ * DESCRIPTION: Queue a membership change for the next batch. Nothing is kept without listeners.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::notifyListeners(MembershipEventType type, NodeId node, long heartbeat) {
+    if (listeners.empty()) {
+        return;
+    }
+    MembershipEvent event;
+    event.type = type;
+    event.addr = node.toAddress();
+    event.heartbeat = heartbeat;
+    event.timestamp = par->getcurrtime();
+    pendingEvents.push_back(event);
+}
+
+/**
+ * FUNCTION NAME: flushMembershipEvents
+ *
+ * DESCRIPTION: Deliver this tick's membership changes to every listener
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::flushMembershipEvents() {
+    if (pendingEvents.empty()) {
+        return;
+    }
+    for (auto listener: listeners) {
+        listener->membershipChanged(&memberNode->addr, pendingEvents);
+    }
+    pendingEvents.clear();
+}
+
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::sendWithMemberList(MsgTypes msgType, Address* targetAddress) {
+
+    // across zones only this zone's representatives are gossiped
+    if (isInMyZone(NodeId(*targetAddress).getid())) {
+        return sendEntries(msgType, targetAddress, memberNode->memberList);
+    }
+
+    vector<int> reps = zoneRepresentatives(selector.zoneOf(self.getid()));
+    vector<MemberListEntry> entries;
+    for(auto value: memberNode->memberList) {
+        if (find(reps.begin(), reps.end(), value.getid()) != reps.end()) {
+            entries.push_back(value);
+        }
+    }
+    return sendEntries(msgType, targetAddress, entries);
+}
+
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::sendEntries(MsgTypes msgType, Address* targetAddress, vector<MemberListEntry>& entries) {
+
+
+    size_t entrySize = Codec::ENTRY_SIZE;
+    // total size: Entry size * count memberlist
+    int memberlistCount = entries.size();
+    size_t totalSize = entrySize * memberlistCount;
+    // MessageHdr(4 byte) + Address(6 byte) + Memberlist Size(4 byte) + memberlist size (Entry size * count memberlist)
+    size_t size = sizeof(MessageHdr) + sizeof(memberNode->addr.addr) +  sizeof(int) +  totalSize;
+    char* msg = (char*) malloc(size);
+    int offset2 = 0;
+    memcpy(msg, &msgType, sizeof(MsgTypes));
+    offset2 += sizeof(MsgTypes);
+    memcpy((char *)(msg+offset2), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    offset2 += sizeof(memberNode->addr.addr);
+    memcpy((char *)(msg+offset2), &memberlistCount, sizeof(int));
+    offset2 += sizeof(int);
+    for(auto value: entries) {
+        Codec::encode(msg+offset2, value.getnode(), value.heartbeat);
+        offset2 += entrySize;
+    }
+    cout << "size - offset2 " << (size-offset2) << endl;
+    int sent = emulNet->ENsend(&memberNode->addr, targetAddress, (char *)msg, size);
+    cout << "try to free msg " << sizeof(msg) << endl;
+    free(msg);
+    cout << "done" << endl;
+    msg=NULL;
+
+    // lost messages are gossip's business, refused ones the caller's
+    return sent != EN_BACKPRESSURE;
+}
+
+/**
+ * FUNCTION NAME: gossipTo
+ *
+ * DESCRIPTION: Gossip to a peer of this zone, by digest when DIGEST_RANGES is set.
+ * 				Returns false if EmulNet refused the message with backpressure.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+bool MP1NodeT<PeerSelector, FailureDetector, Codec>::gossipTo(Address* targetAddress) {
+    // no member list goes out, the news probes the target and its answer tells us it is alive
+    if (isProbed(NodeId(*targetAddress).getid())) {
+        if (!sendDisseminate(targetAddress)) {
+            return false;
+        }
+        probes.emplace(NodeId(*targetAddress), par->getcurrtime());
+        return true;
+    }
+    if (par->DIGEST_RANGES <= 0 || !isInMyZone(NodeId(*targetAddress).getid())) {
+        return sendWithMemberList(HEARTBEATREQ, targetAddress);
+    }
+
+    vector<unsigned short> digest;
+    computeDigest(digest);
+
+    // own entry goes along, so the heartbeat is still pushed every tick
+    long heartbeat = 0;
+    for(auto value: memberNode->memberList) {
+        if (value.getnode() == self) {
+            heartbeat = value.heartbeat;
+        }
+    }
+
+    // MessageHdr(4 byte) + Address(6 byte) + Memberlist Size(4 byte) + own entry
+    // + range count(4 byte) + range hashes(2 byte each)
+    size_t size = sizeof(MessageHdr) + sizeof(memberNode->addr.addr) + sizeof(int)
+                + Codec::ENTRY_SIZE
+                + sizeof(int) + sizeof(unsigned short) * digest.size();
+    char* msg = (char*) malloc(size);
+    int offset = 0;
+    MsgTypes msgType = DIGESTREQ;
+    memcpy(msg, &msgType, sizeof(MsgTypes));
+    offset += sizeof(MsgTypes);
+    memcpy((msg+offset), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    offset += sizeof(memberNode->addr.addr);
+    int count = 1;
+    memcpy((msg+offset), &count, sizeof(int));
+    offset += sizeof(int);
+    Codec::encode(msg+offset, self, heartbeat);
+    offset += Codec::ENTRY_SIZE;
+    int ranges = digest.size();
+    memcpy((msg+offset), &ranges, sizeof(int));
+    offset += sizeof(int);
+    memcpy((msg+offset), digest.data(), sizeof(unsigned short) * digest.size());
+    int sent = emulNet->ENsend(&memberNode->addr, targetAddress, msg, size);
+    free(msg);
+    return sent != EN_BACKPRESSURE;
+}
+
+/**
+ * FUNCTION NAME: gossipOrDefer
+ *
+ * DESCRIPTION: Gossip to a peer, or keep it for the next tick while EmulNet
+ * 				pushes back. The message is only built when it can be sent.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::gossipOrDefer(Address* targetAddress) {
+    if (emulNet->ENcanSend(&memberNode->addr, targetAddress) && gossipTo(targetAddress)) {
+        return;
+    }
+    for (auto &deferred: deferredGossip) {
+        if (NodeId(deferred) == NodeId(*targetAddress)) {
+            return;
+        }
+    }
+    deferredGossip.push_back(*targetAddress);
+}
+
+/**
+ * FUNCTION NAME: retryDeferredGossip
+ *
+ * DESCRIPTION: Send the gossip deferred by backpressure before this tick's own
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::retryDeferredGossip() {
+    vector<Address> targets;
+    targets.swap(deferredGossip);
+    for (auto &target: targets) {
+        gossipOrDefer(&target);
+    }
+}
+
+/**
+ * FUNCTION NAME: digestRange
+ *
+ * DESCRIPTION: Digest range a member's entry falls into
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::digestRange(int id) {
+    return id % par->DIGEST_RANGES;
+}
+
+/**
+ * FUNCTION NAME: computeDigest
+ *
+ * DESCRIPTION: Hash every digest range over (id, port, heartbeat / DIGEST_BUCKET)
+ * 				of its entries. Entries are mixed independently and summed, so
+ * 				the list order does not matter.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::computeDigest(vector<unsigned short>& digest) {
+    digest.assign(par->DIGEST_RANGES, 0);
+    for(auto value: memberNode->memberList) {
+        unsigned long long h = value.getnode().packed;
+        h ^= (unsigned long long)(value.heartbeat / par->DIGEST_BUCKET) << 40;
+        // splitmix64 finalizer
+        h += 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        digest[digestRange(value.getid())] += (unsigned short)(h ^ (h >> 32));
+    }
+}
+
+/**
+ * FUNCTION NAME: zoneRepresentatives
+ *
+ * DESCRIPTION: Ids of the ZONE_REPS lowest known members of a zone
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+vector<int> MP1NodeT<PeerSelector, FailureDetector, Codec>::zoneRepresentatives(int zone) {
+    vector<int> reps;
+    for(auto value: memberNode->memberList) {
+        if (selector.zoneOf(value.getid()) == zone) {
+            reps.push_back(value.getid());
+        }
+    }
+    if ((int)reps.size() > par->ZONE_REPS) {
+        nth_element(reps.begin(), reps.begin() + par->ZONE_REPS, reps.end());
+        reps.resize(par->ZONE_REPS);
+    }
+    return reps;
+}
+
+/**
+ * FUNCTION NAME: replyToJoinRequests
+ *
+ * DESCRIPTION: Answer all join requests received this tick with one bounded
+ * 				partial view of at most JOIN_VIEW_SIZE members. Gossip fills
+ * 				in the rest of the group afterwards. Joiners that backpressure
+ * 				keeps us from answering wait for the next tick unlisted, so
+ * 				nobody times them out before they can heartbeat.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::replyToJoinRequests() {
+    if (pendingJoins.empty()) {
+        return;
+    }
+
+    vector<MemberListEntry> deferred;
+    vector<Address> joiners;
+    // heartbeat each restarted joiner resumes from, 0 for a new one
+    vector<long> resumed;
+    en_lane lane = emulNet->ENlane(JOINREP);
+    // keep a send for this tick's own gossip, or our heartbeat stalls
+    int sendsLeft = emulNet->ENsendsLeft(&memberNode->addr, lane);
+    if (sendsLeft != INT_MAX) {
+        sendsLeft = max(1, sendsLeft - 1);
+    }
+    for (auto &joiner: pendingJoins) {
+        Address address = joiner.getnode().toAddress();
+        if ((int)joiners.size() >= sendsLeft || !emulNet->ENcanSend(&memberNode->addr, &address, lane)) {
+            deferred.push_back(joiner);
+            continue;
+        }
+        long heartbeat = resumeHeartbeat(joiner.getnode(), joiner.heartbeat);
+        if (PeerSelector::PARTIAL_VIEW) {
+            addNeighbor(joiner.getnode(), heartbeat);
+        } else {
+            updateMemberList(joiner.getnode(), heartbeat);
+        }
+        joiners.push_back(address);
+        resumed.push_back(heartbeat > joiner.heartbeat ? heartbeat : 0);
+    }
+
+    // myself first, then a random sample of everybody else. Probed members
+    // send no member lists, so a flat group hands a joiner all of it that fits
+    int viewSize = par->JOIN_VIEW_SIZE;
+    if (par->DISSEMINATION_MULT > 0 && !PeerSelector::ZONED && !PeerSelector::PARTIAL_VIEW) {
+        // EmulNet drops messages of MAX_MSG_SIZE, and a restarted joiner's own entry goes along
+        int headerSize = sizeof(en_msg) + sizeof(MessageHdr) + sizeof(memberNode->addr.addr) + sizeof(int);
+        viewSize = (par->MAX_MSG_SIZE - headerSize) / Codec::ENTRY_SIZE - 1;
+    }
+    vector<MemberListEntry> view;
+    vector<int> others;
+    for (int i = 0; i < (int)memberNode->memberList.size(); i++) {
+        if (memberNode->memberList[i].getnode() == self) {
+            view.push_back(memberNode->memberList[i]);
+            if (par->DISSEMINATION_MULT > 0) {
+                view.back().setheartbeat(incarnation);
+            }
+        } else {
+            others.push_back(i);
+        }
+    }
+    for (int i = 0; i < (int)others.size() && (int)view.size() < viewSize; i++) {
+        int j = i + rand() % (others.size() - i);
+        swap(others[i], others[j]);
+        view.push_back(memberNode->memberList[others[i]]);
+    }
+    // a partial view joiner also learns of our passive view
+    for (auto node: passiveView) {
+        if ((int)view.size() >= viewSize) {
+            break;
+        }
+        view.push_back(MemberListEntry(node, 0, par->getcurrtime()));
+    }
+
+    for (int k = 0; k < (int)joiners.size(); k++) {
+        Address joiner = joiners[k];
+        int joinerId = NodeId(joiner).getid();
+        vector<MemberListEntry> reply = view;
+        // the joiner takes its own entry's heartbeat over
+        if (resumed[k] > 0) {
+            reply.push_back(MemberListEntry(NodeId(joiner), resumed[k], par->getcurrtime()));
+        }
+        if (!PeerSelector::ZONED) {
+            sendEntries(JOINREP, &joiner, reply);
+            continue;
+        }
+        // a zoned joiner also needs its own zone's representatives
+        vector<int> reps = zoneRepresentatives(selector.zoneOf(joinerId));
+        for(auto value: memberNode->memberList) {
+            if (find(reps.begin(), reps.end(), value.getid()) == reps.end()) {
+                continue;
+            }
+            bool present = std::any_of(reply.begin(), reply.end(), [&](MemberListEntry& entry) {
+                return entry.peer == value.peer;
+            });
+            if (!present) {
+                reply.push_back(value);
+            }
+        }
+        sendEntries(JOINREP, &joiner, reply);
+    }
+    pendingJoins.swap(deferred);
+}
+
+template <class PeerSelector, class FailureDetector, class Codec>
+Address MP1NodeT<PeerSelector, FailureDetector, Codec>::buildAddress(int id, short port) {
+    return NodeId(id, port).toAddress();
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Bytes held by this node: its membership state and queued messages
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+long MP1NodeT<PeerSelector, FailureDetector, Codec>::memoryUsage() {
+    long bytes = sizeof(*this) + sizeof(Member);
+    bytes += memberNode->memberList.capacity() * sizeof(MemberListEntry);
+    bytes += kicklist.capacity() * sizeof(MemberListEntry);
+    bytes += tombstones.capacity() * sizeof(MemberListEntry);
+    bytes += detector.memoryUsage();
+    // hash nodes carry a next pointer and the cached hash, plus one bucket pointer each
+    bytes += dissemination.size() * (sizeof(NodeId) + sizeof(DisseminationEntry) + 2 * sizeof(void *));
+    bytes += dissemination.bucket_count() * sizeof(void *);
+    bytes += probes.size() * (sizeof(NodeId) + sizeof(long) + 2 * sizeof(void *));
+    bytes += probes.bucket_count() * sizeof(void *);
+    bytes += pendingEvents.capacity() * sizeof(MembershipEvent);
+    bytes += pendingJoins.capacity() * sizeof(MemberListEntry);
+    bytes += deferredGossip.capacity() * sizeof(Address);
+    bytes += passiveView.capacity() * sizeof(NodeId);
+    bytes += neighborRequests.capacity() * sizeof(MemberListEntry);
+    bytes += inboxBytes + memberNode->mp1q.capacity() * sizeof(InboxSlot);
+    return bytes;
+}
+
+/**
+ * FUNCTION NAME: logMemoryUsage
+ *
+ * DESCRIPTION: Write this node's memory breakdown to the stats log
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::logMemoryUsage() {
+    log->LOG(&memberNode->addr, "#STATSLOG# mem list=%ld passive=%ld queue=%ld (%d msgs) kicklist=%ld total=%ld shed=%ld dropped=%ld",
+        (long)(memberNode->memberList.capacity() * sizeof(MemberListEntry)),
+        (long)(passiveView.capacity() * sizeof(NodeId)),
+        inboxBytes + (long)(memberNode->mp1q.capacity() * sizeof(InboxSlot)),
+        memberNode->mp1q.size(),
+        (long)(kicklist.capacity() * sizeof(MemberListEntry)),
+        memoryUsage(),
+        shedMessages,
+        memberNode->mp1q.getDropped());
+}
+
+/**
+ * FUNCTION NAME: logSweepStats
+ *
+ * DESCRIPTION: Write how much of the member list the failure sweep checked and
+ * 				how late it got to members, against the TFAIL round bound
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::logSweepStats() {
+    log->LOG(&memberNode->addr, "#STATSLOG# sweep examined=%ld max_slice=%d max_round=%ld bound=%d max_suspect_delay=%ld max_removal_delay=%ld",
+        sweepExamined, sweepMaxSlice, sweepMaxRound, TFAIL, maxSuspectDelay, maxRemovalDelay);
+}
+
+/**
+ * FUNCTION NAME: isNullAddress
+ *
+ * DESCRIPTION: Function checks if the address is NULL
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+int MP1NodeT<PeerSelector, FailureDetector, Codec>::isNullAddress(Address *addr) {
+	return (memcmp(addr->addr, NULLADDR, 6) == 0 ? 1 : 0);
+}
+
+/**
+ * FUNCTION NAME: getJoinAddress
+ *
+ * DESCRIPTION: Returns the Address of the coordinator
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+Address MP1NodeT<PeerSelector, FailureDetector, Codec>::getJoinAddress() {
+    return NodeId(1, 0).toAddress();
+}
+
+/**
+ * FUNCTION NAME: initMemberListTable
+ *
+ * DESCRIPTION: Initialize the membership list
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::initMemberListTable(Member *memberNode) {
+	memberNode->memberList.clear();
+
+    MemberListEntry entry(self, 0, par->getcurrtime());
+    memberNode->memberList.push_back(entry);
+    memberNode->myPos = memberNode->memberList.begin();
+}
+
+/**
+ * FUNCTION NAME: printAddress
+ *
+ * DESCRIPTION: Print the Address
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+void MP1NodeT<PeerSelector, FailureDetector, Codec>::printAddress(Address *addr)
+{
+    printf("%d.%d.%d.%d:%d \n",  addr->addr[0],addr->addr[1],addr->addr[2],
+                                                       addr->addr[3], *(short*)&addr->addr[4]) ;
+}
+
+/*
+ * Standard configurations
+ */
+template class MP1NodeT<UniformPeerSelector, TimeoutDetector, PackedEntryCodec>;
+template class MP1NodeT<UniformPeerSelector, PhiAccrualDetector, PackedEntryCodec>;
+template class MP1NodeT<ZonedPeerSelector, TimeoutDetector, PackedEntryCodec>;
+template class MP1NodeT<ZonedPeerSelector, PhiAccrualDetector, PackedEntryCodec>;
+template class MP1NodeT<ActiveViewSelector, TimeoutDetector, PackedEntryCodec>;
+template class MP1NodeT<ActiveViewSelector, PhiAccrualDetector, PackedEntryCodec>;
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: New node specialized for the configured peer selection and failure detector
+ */
+MP1Node *MP1Node::create(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
+	if ( params->VIEW_SIZE > 0 ) {
+		if ( params->PHI_THRESHOLD > 0 ) {
+			return new ViewPhiNode(member, params, emul, log, address);
+		}
+		return new ViewTimeoutNode(member, params, emul, log, address);
+	}
+	if ( params->ZONE_SIZE > 0 ) {
+		if ( params->PHI_THRESHOLD > 0 ) {
+			return new ZonedPhiNode(member, params, emul, log, address);
+		}
+		return new ZonedTimeoutNode(member, params, emul, log, address);
+	}
+	if ( params->PHI_THRESHOLD > 0 ) {
+		return new FlatPhiNode(member, params, emul, log, address);
+	}
+	return new FlatTimeoutNode(member, params, emul, log, address);
 }
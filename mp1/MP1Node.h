@@ -14,12 +14,14 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "MP1Policies.h"
+#include "CoroRuntime.h"
 
 /**
  * Macros
  */
-#define TREMOVE 20
-#define TFAIL 5
+// how long a removed member is refused when stale gossip brings it back
+#define TTOMBSTONE (2 * TREMOVE)
 
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
@@ -33,6 +35,16 @@ enum MsgTypes{
     JOINREP,
     HEARTBEATREQ,
     HEARTBEATREP,
+    DIGESTREQ,
+    DIGESTREP,
+    DISSEMINATE,
+    NEIGHBORREQ,
+    DISCONNECT,
+    SHUFFLEREQ,
+    SHUFFLEREP,
+    LEAVE,
+    APPDATA,
+    DISSEMINATEACK,
     DUMMYLASTMSGTYPE,
 };
 
@@ -45,32 +57,174 @@ typedef struct MessageHdr {
 	enum MsgTypes msgType;
 }MessageHdr;
 
+/**
+ * Kinds of membership news piggybacked on DISSEMINATE messages
+ */
+enum DisseminationType {
+    DISSEMINATE_JOIN,
+    DISSEMINATE_ALIVE,
+    DISSEMINATE_SUSPECT,
+    DISSEMINATE_DEAD,
+    DISSEMINATE_LEFT,
+};
+
+/**
+ * STRUCT NAME: DisseminationEntry
+ *
+ * DESCRIPTION: A recent membership change and how many more messages carry it
+ */
+typedef struct DisseminationEntry {
+	NodeId node;
+	long heartbeat;
+	enum DisseminationType type;
+	int transmissions;
+}DisseminationEntry;
+
+/**
+ * Membership change kinds delivered to listeners
+ */
+enum MembershipEventType {
+    MEMBER_JOINED,
+    MEMBER_SUSPECTED,
+    MEMBER_ALIVE,
+    MEMBER_REMOVED,
+    // moved from the active to the passive view, still believed alive
+    MEMBER_DEMOTED,
+};
+
+/**
+ * STRUCT NAME: MembershipEvent
+ *
+ * DESCRIPTION: A single change to this node's membership list
+ */
+typedef struct MembershipEvent {
+	enum MembershipEventType type;
+	Address addr;
+	long heartbeat;
+	long timestamp;
+}MembershipEvent;
+
+/**
+ * CLASS NAME: MembershipListener
+ *
+ * DESCRIPTION: Receives the membership changes of one node, batched once per tick.
+ * 				Events are in the order they happened.
+ */
+class MembershipListener {
+public:
+	virtual void membershipChanged(Address *self, const vector<MembershipEvent> &events) = 0;
+	virtual ~MembershipListener() {}
+};
+
 /**
  * CLASS NAME: MP1Node
  *
- * DESCRIPTION: Class implementing Membership protocol functionalities for failure detection
+ * DESCRIPTION: A node as Application drives it. Implemented by MP1NodeT for
+ * 				each standard combination of protocol policies; create()
+ * 				picks the one the configuration asks for.
  */
 class MP1Node {
+public:
+	static MP1Node *create(Member *, Params *, EmulNet *, Log *, Address *);
+	virtual Member * getMemberNode() = 0;
+	virtual int recvLoop() = 0;
+	virtual void nodeStart(char *servaddrstr, short serverport) = 0;
+	virtual int finishUpThisNode() = 0;
+	virtual int leaveGroup() = 0;
+	virtual void nodeLoop() = 0;
+#ifdef HAVE_CORO_RUNTIME
+	virtual NodeTask protocol(CoroExecutor *executor, int slot) = 0;
+#endif
+	virtual long memoryUsage() = 0;
+	virtual void logMemoryUsage() = 0;
+	virtual void logSweepStats() = 0;
+	virtual bool samplePeer(Address *peer) = 0;
+	virtual void addListener(MembershipListener *listener) = 0;
+	virtual void removeListener(MembershipListener *listener) = 0;
+	virtual ~MP1Node() {}
+};
+
+/**
+ * CLASS NAME: MP1NodeT
+ *
+ * DESCRIPTION: Class implementing Membership protocol functionalities for failure detection,
+ * 				specialized at compile time over who to gossip to and how the
+ * 				group is laid out (PeerSelector: flat, zoned or partial view),
+ * 				when members are suspected and removed (FailureDetector) and how
+ * 				list entries are encoded (Codec). Nothing in the per-message
+ * 				path dispatches virtually. The member list, tombstones and
+ * 				dissemination buffer are the node's own state, the same in
+ * 				every specialization.
+ */
+template <class PeerSelector, class FailureDetector, class Codec>
+class MP1NodeT: public MP1Node {
 private:
 	EmulNet *emulNet;
 	Log *log;
 	Params *par;
 	Member *memberNode;
 	char NULLADDR[6];
+	// this node's own id, the packed form of memberNode->addr
+	NodeId self;
 	vector<MemberListEntry> kicklist;
+	vector<MemberListEntry> tombstones;
+	vector<MembershipListener *> listeners;
+	vector<MembershipEvent> pendingEvents;
+	vector<MemberListEntry> pendingJoins;
+	// partial views: peers known besides the active view (memberList), and
+	// peers asked to join the active view, timestamped with the request tick
+	vector<NodeId> passiveView;
+	vector<MemberListEntry> neighborRequests;
+	// gossip targets refused by EmulNet backpressure, retried next tick
+	vector<Address> deferredGossip;
+	// JOINREQ refused by backpressure, sent again next tick
+	bool joinDeferred;
+	// tick the last JOINREQ went out, it is repeated until a JOINREP arrives
+	long joinSentAt;
+	PeerSelector selector;
+	FailureDetector detector;
+	// membership news still to be piggybacked, one entry per member
+	unordered_map<NodeId, DisseminationEntry> dissemination;
+	// heartbeat we last refuted a suspicion with, 0 before the first; probing
+	// members keep it as ours instead of every heartbeat
+	long incarnation;
+	// probed members that have not answered yet, with the tick of the first unanswered probe
+	unordered_map<NodeId, long> probes;
+	// payload bytes waiting in mp1q
+	long inboxBytes;
+	// messages dropped from mp1q to stay within NODE_MEM_BUDGET
+	long shedMessages;
+	// incremental sweep: next member list index to check and the tick the round started
+	int sweepCursor;
+	long sweepRoundStart;
+	// failure sweep instrumentation
+	long sweepExamined;
+	int sweepMaxSlice;
+	long sweepMaxRound;
+	long maxSuspectDelay;
+	long maxRemovalDelay;
 
 public:
-	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
+	MP1NodeT(Member *, Params *, EmulNet *, Log *, Address *);
 	Member * getMemberNode() {
 		return memberNode;
 	}
 	int recvLoop();
 	static int enqueueWrapper(void *env, char *buff, int size);
+	int enqueueMessage(char *buff, int size);
+	long memoryUsage();
+	void logMemoryUsage();
+	void logSweepStats();
+	bool samplePeer(Address *peer);
 	void nodeStart(char *servaddrstr, short serverport);
 	int initThisNode(Address *joinaddr);
 	int introduceSelfToGroup(Address *joinAddress);
 	int finishUpThisNode();
+	int leaveGroup();
 	void nodeLoop();
+#ifdef HAVE_CORO_RUNTIME
+	NodeTask protocol(CoroExecutor *executor, int slot);
+#endif
 	void checkMessages();
 	bool recvCallBack(void *env, char *data, int size);
 	void nodeLoopOps();
@@ -84,13 +238,82 @@ public:
     bool handleHeartbeatResponse(Member* member, char* data, int size);
     bool handleJoinRequest(Member* member, char* data, int size);
     bool handleJoinResponse(Member* member, char* data, int size);
+    bool handleDigestRequest(Member* member, char* data, int size);
+    bool handleDigestResponse(Member* member, char* data, int size);
+    bool handleDisseminate(Member* member, char* data, int size);
+    bool handleNeighborRequest(Member* member, char* data, int size);
+    bool handleDisconnect(Member* member, char* data, int size);
+    bool handleShuffleRequest(Member* member, char* data, int size);
+    bool handleShuffleResponse(Member* member, char* data, int size);
+    bool handleLeave(Member* member, char* data, int size);
     // helper
     Address buildAddress(int id, short port);
-    void mergeMemberlist(Member* member, char* data, int size);
+    int mergeMemberlist(Member* member, char* data, int size);
     bool sendWithMemberList(MsgTypes msgType, Address* targetAddress);
-    void updateMemberList(Address& address, long heartbeat);
+    bool sendEntries(MsgTypes msgType, Address* targetAddress, vector<MemberListEntry>& entries);
+    void replyToJoinRequests();
+    void updateMemberList(NodeId node, long heartbeat);
+    void addMember(NodeId node, long heartbeat);
+    // digest-based anti-entropy
+    bool gossipTo(Address* targetAddress);
+    void gossipOrDefer(Address* targetAddress);
+    void retryDeferredGossip();
+    int digestRange(int id);
+    void computeDigest(vector<unsigned short>& digest);
     void cleanupMembers();
-	virtual ~MP1Node();
+    void sweepMembers();
+    void suspectMember(MemberListEntry& entry);
+    void removeMember(vector<MemberListEntry>::iterator value);
+    void unlinkMember(vector<MemberListEntry>::iterator value);
+    // graceful departure
+    void leaveMember(NodeId node, long heartbeat);
+    void sendLeave(NodeId node, long heartbeat);
+    // infection-style dissemination
+    void disseminate(NodeId node, long heartbeat, DisseminationType type);
+    long ownHeartbeat();
+    int retransmitLimit();
+    bool sendDisseminate(Address* targetAddress, MsgTypes msgType = DISSEMINATE);
+    bool isProbed(int id);
+    bool isSuspected(NodeId node);
+    void checkProbes();
+    bool isTombstoned(NodeId node, long heartbeat = 0);
+    long resumeHeartbeat(NodeId node, long heartbeat);
+    // zone-aware gossip
+    bool isInMyZone(int id);
+    bool admitForeignMember(int id);
+    vector<int> zoneRepresentatives(int zone);
+    // partial view peer sampling
+    int neighborCount();
+    bool isNeighbor(NodeId node);
+    void addNeighbor(NodeId node, long heartbeat);
+    void demoteNeighbor(vector<MemberListEntry>::iterator value);
+    void checkNeighbor(Address* sourceAddress);
+    void addPassive(NodeId node);
+    void maintainViews();
+    bool sendViewMessage(MsgTypes msgType, Address* targetAddress, char flag);
+    void sampleEntries(vector<MemberListEntry>& entries, int count);
+    // membership change subscription
+    void addListener(MembershipListener *listener);
+    void removeListener(MembershipListener *listener);
+    void notifyListeners(MembershipEventType type, NodeId node, long heartbeat);
+    void flushMembershipEvents();
+	virtual ~MP1NodeT();
 };
 
+/*
+ * Standard configurations, instantiated once in MP1Node.cpp
+ */
+extern template class MP1NodeT<UniformPeerSelector, TimeoutDetector, PackedEntryCodec>;
+extern template class MP1NodeT<UniformPeerSelector, PhiAccrualDetector, PackedEntryCodec>;
+extern template class MP1NodeT<ZonedPeerSelector, TimeoutDetector, PackedEntryCodec>;
+extern template class MP1NodeT<ZonedPeerSelector, PhiAccrualDetector, PackedEntryCodec>;
+extern template class MP1NodeT<ActiveViewSelector, TimeoutDetector, PackedEntryCodec>;
+extern template class MP1NodeT<ActiveViewSelector, PhiAccrualDetector, PackedEntryCodec>;
+typedef MP1NodeT<UniformPeerSelector, TimeoutDetector, PackedEntryCodec> FlatTimeoutNode;
+typedef MP1NodeT<UniformPeerSelector, PhiAccrualDetector, PackedEntryCodec> FlatPhiNode;
+typedef MP1NodeT<ZonedPeerSelector, TimeoutDetector, PackedEntryCodec> ZonedTimeoutNode;
+typedef MP1NodeT<ZonedPeerSelector, PhiAccrualDetector, PackedEntryCodec> ZonedPhiNode;
+typedef MP1NodeT<ActiveViewSelector, TimeoutDetector, PackedEntryCodec> ViewTimeoutNode;
+typedef MP1NodeT<ActiveViewSelector, PhiAccrualDetector, PackedEntryCodec> ViewPhiNode;
+
 #endif /* _MP1NODE_H_ */
@@ -0,0 +1,195 @@
+/**********************************
+ * FILE NAME: MP1Policies.h
+ *
+ * DESCRIPTION: Policy types MP1NodeT is specialized over: who a node
+ * 				gossips to and how the group is laid out (flat, in zones or
+ * 				in partial views), when it suspects and removes a member, and
+ * 				how member list entries are put on the wire
+ **********************************/
+
+#ifndef _MP1POLICIES_H_
+#define _MP1POLICIES_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "ArrivalWindow.h"
+
+/**
+ * Macros
+ */
+#define TREMOVE 20
+#define TFAIL 5
+
+/**
+ * CLASS NAME: UniformPeerSelector
+ *
+ * DESCRIPTION: Gossip to one member drawn uniformly from the whole list,
+ * 				to nobody when the draw is this node itself
+ */
+class UniformPeerSelector {
+public:
+	static const bool ZONED = false;
+	static const bool PARTIAL_VIEW = false;
+	UniformPeerSelector(Params *par) {}
+	int zoneOf(int id) {
+		return 0;
+	}
+	void select(vector<MemberListEntry> &list, NodeId self, vector<NodeId> &targets) {
+		NodeId drawn = list[rand() % list.size()].getnode();
+		if ( drawn != self ) {
+			targets.push_back(drawn);
+		}
+	}
+};
+
+/**
+ * CLASS NAME: ZonedPeerSelector
+ *
+ * DESCRIPTION: Gossip to a random peer of this zone every tick, and to a random
+ * 				foreign representative as often as a uniform pick would choose one
+ */
+class ZonedPeerSelector {
+private:
+	Params *par;
+public:
+	static const bool ZONED = true;
+	static const bool PARTIAL_VIEW = false;
+	ZonedPeerSelector(Params *par): par(par) {}
+	/**
+	 * Zones are ranges of ZONE_SIZE consecutive ids
+	 */
+	int zoneOf(int id) {
+		return (id - 1) / par->ZONE_SIZE;
+	}
+	void select(vector<MemberListEntry> &list, NodeId self, vector<NodeId> &targets) {
+		vector<int> local;
+		vector<int> foreign;
+		for ( int i = 0; i < (int)list.size(); i++ ) {
+			if ( list[i].getnode() == self ) {
+				continue;
+			}
+			if ( zoneOf(list[i].getid()) == zoneOf(self.getid()) ) {
+				local.push_back(i);
+			}
+			else {
+				foreign.push_back(i);
+			}
+		}
+		if ( !local.empty() ) {
+			targets.push_back(list[local[rand() % local.size()]].getnode());
+		}
+		if ( !foreign.empty() && (int)(rand() % list.size()) < (int)foreign.size() ) {
+			targets.push_back(list[foreign[rand() % foreign.size()]].getnode());
+		}
+	}
+};
+
+/**
+ * CLASS NAME: ActiveViewSelector
+ *
+ * DESCRIPTION: Gossip to every member of a partial view node's active view.
+ * 				The view is small and its members only hear from each other
+ * 				directly, so each of them gets our heartbeat every tick.
+ */
+class ActiveViewSelector {
+public:
+	static const bool ZONED = false;
+	static const bool PARTIAL_VIEW = true;
+	ActiveViewSelector(Params *par) {}
+	int zoneOf(int id) {
+		return 0;
+	}
+	void select(vector<MemberListEntry> &list, NodeId self, vector<NodeId> &targets) {
+		for ( auto &entry : list ) {
+			if ( entry.getnode() != self ) {
+				targets.push_back(entry.getnode());
+			}
+		}
+	}
+};
+
+/**
+ * CLASS NAME: TimeoutDetector
+ *
+ * DESCRIPTION: Suspect a member after TFAIL ticks without a newer heartbeat,
+ * 				remove it after TREMOVE
+ */
+class TimeoutDetector {
+public:
+	TimeoutDetector(Params *par) {}
+	void heard(NodeId node, long now) {}
+	void forget(NodeId node) {}
+	bool isSuspect(MemberListEntry &entry, long now) {
+		return (now - entry.gettimestamp()) > TFAIL;
+	}
+	bool isExpired(MemberListEntry &entry, long now) {
+		return (now - entry.gettimestamp()) > TREMOVE;
+	}
+	long memoryUsage() {
+		return 0;
+	}
+};
+
+/**
+ * CLASS NAME: PhiAccrualDetector
+ *
+ * DESCRIPTION: Suspect a member once its phi passes half of PHI_THRESHOLD,
+ * 				remove it once phi passes PHI_THRESHOLD
+ */
+class PhiAccrualDetector {
+private:
+	Params *par;
+	unordered_map<NodeId, ArrivalWindow> arrivals;
+public:
+	PhiAccrualDetector(Params *par): par(par) {}
+	void heard(NodeId node, long now) {
+		arrivals[node].record(now);
+	}
+	void forget(NodeId node) {
+		arrivals.erase(node);
+	}
+	/**
+	 * Suspicion level of a member, 0 if it is not tracked
+	 */
+	double suspicion(NodeId node, long now) {
+		unordered_map<NodeId, ArrivalWindow>::iterator window = arrivals.find(node);
+		if ( window == arrivals.end() ) {
+			return 0;
+		}
+		return window->second.phi(now);
+	}
+	bool isSuspect(MemberListEntry &entry, long now) {
+		return suspicion(entry.getnode(), now) > par->PHI_THRESHOLD / 2;
+	}
+	bool isExpired(MemberListEntry &entry, long now) {
+		return suspicion(entry.getnode(), now) > par->PHI_THRESHOLD;
+	}
+	long memoryUsage() {
+		// hash nodes carry a next pointer and the cached hash, plus one bucket pointer each
+		return arrivals.size() * (sizeof(NodeId) + sizeof(ArrivalWindow) + 2 * sizeof(void *))
+			+ arrivals.bucket_count() * sizeof(void *);
+	}
+};
+
+/**
+ * CLASS NAME: PackedEntryCodec
+ *
+ * DESCRIPTION: A member list entry as Address(6 byte) + heartbeat(8 byte)
+ */
+class PackedEntryCodec {
+public:
+	static const int ENTRY_SIZE = 6 + sizeof(long);
+	static void encode(char *data, NodeId node, long heartbeat) {
+		node.copyTo(data);
+		memcpy(data + 6, &heartbeat, sizeof(long));
+	}
+	static void decode(char *data, NodeId &node, long &heartbeat) {
+		Address address;
+		memcpy(&address.addr, data, sizeof(address.addr));
+		node = NodeId(address);
+		memcpy(&heartbeat, data + 6, sizeof(long));
+	}
+};
+
+#endif /* _MP1POLICIES_H_ */
@@ -11,6 +11,196 @@
  */
 q_elt::q_elt(void *elt, int size): elt(elt), size(size) {}
 
+/**
+ * Constructor
+ */
+InboxRing::InboxRing(int capacity): slots(NULL), dropped(0) {
+	allocate(capacity);
+}
+
+/**
+ * Copy constructor
+ */
+InboxRing::InboxRing(const InboxRing &anotherRing): slots(NULL), dropped(0) {
+	*this = anotherRing;
+}
+
+/**
+ * Assignment operator overloading. Not safe against concurrent producers.
+ */
+InboxRing& InboxRing::operator =(const InboxRing &anotherRing) {
+	if ( this == &anotherRing ) {
+		return *this;
+	}
+	allocate(anotherRing.slots == NULL ? 0 : anotherRing.mask + 1);
+	if ( slots == NULL ) {
+		dropped.store(anotherRing.dropped.load());
+		return *this;
+	}
+	unsigned long from = anotherRing.dequeuePos.load();
+	unsigned long to = anotherRing.enqueuePos.load();
+	for ( unsigned long pos = from; pos != to; pos++ ) {
+		InboxSlot &source = anotherRing.slots[pos & anotherRing.mask];
+		InboxSlot &slot = slots[pos & mask];
+		slot.elt = source.elt;
+		slot.size = source.size;
+		slot.seq.store(pos + 1);
+	}
+	// Free slots are handed out from the new positions onwards
+	for ( unsigned long pos = to; pos != from + mask + 1; pos++ ) {
+		slots[pos & mask].seq.store(pos);
+	}
+	enqueuePos.store(to);
+	dequeuePos.store(from);
+	dropped.store(anotherRing.dropped.load());
+	return *this;
+}
+
+/**
+ * Destructor
+ */
+InboxRing::~InboxRing() {
+	delete[] slots;
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Replace the slots with an empty ring of at least capacity slots,
+ * 				or with no slots at all for a capacity of 0
+ */
+void InboxRing::allocate(int capacity) {
+	delete[] slots;
+	slots = NULL;
+	mask = 0;
+	enqueuePos.store(0);
+	dequeuePos.store(0);
+	if ( capacity <= 0 ) {
+		return;
+	}
+	unsigned long slotCount = 2;
+	while ( slotCount < (unsigned long) capacity ) {
+		slotCount <<= 1;
+	}
+	slots = new InboxSlot[slotCount];
+	mask = slotCount - 1;
+	for ( unsigned long i = 0; i < slotCount; i++ ) {
+		slots[i].seq.store(i, memory_order_relaxed);
+	}
+}
+
+/**
+ * FUNCTION NAME: resize
+ *
+ * DESCRIPTION: Change the capacity of an empty ring
+ */
+void InboxRing::resize(int capacity) {
+	assert(empty());
+	allocate(capacity);
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: Claim the next slot with a CAS on enqueuePos, fill it, then
+ * 				publish it to the consumer through the slot's seq
+ *
+ * RETURNS:
+ * false if the ring is full
+ */
+bool InboxRing::push(void *elt, int size) {
+	InboxSlot *slot;
+	if ( slots == NULL ) {
+		dropped.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+	unsigned long pos = enqueuePos.load(memory_order_relaxed);
+	for ( ;; ) {
+		slot = &slots[pos & mask];
+		long diff = (long) slot->seq.load(memory_order_acquire) - (long) pos;
+		if ( diff == 0 ) {
+			if ( enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed) ) {
+				break;
+			}
+		}
+		else if ( diff < 0 ) {
+			dropped.fetch_add(1, memory_order_relaxed);
+			return false;
+		}
+		else {
+			pos = enqueuePos.load(memory_order_relaxed);
+		}
+	}
+	slot->elt = elt;
+	slot->size = size;
+	slot->seq.store(pos + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: pop
+ *
+ * DESCRIPTION: Take the oldest published message. Consumer only.
+ *
+ * RETURNS:
+ * false if no message is ready
+ */
+bool InboxRing::pop(q_elt &element) {
+	if ( slots == NULL ) {
+		return false;
+	}
+	unsigned long pos = dequeuePos.load(memory_order_relaxed);
+	InboxSlot *slot = &slots[pos & mask];
+	if ( slot->seq.load(memory_order_acquire) != pos + 1 ) {
+		return false;
+	}
+	element.elt = slot->elt;
+	element.size = slot->size;
+	slot->seq.store(pos + mask + 1, memory_order_release);
+	dequeuePos.store(pos + 1, memory_order_relaxed);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: empty
+ *
+ * DESCRIPTION: Check if no message is ready for the consumer
+ */
+bool InboxRing::empty() {
+	if ( slots == NULL ) {
+		return true;
+	}
+	unsigned long pos = dequeuePos.load(memory_order_relaxed);
+	return slots[pos & mask].seq.load(memory_order_acquire) != pos + 1;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Messages claimed but not yet popped
+ */
+int InboxRing::size() {
+	return (int)(enqueuePos.load(memory_order_relaxed) - dequeuePos.load(memory_order_relaxed));
+}
+
+/**
+ * FUNCTION NAME: capacity
+ *
+ * DESCRIPTION: Number of slots
+ */
+int InboxRing::capacity() {
+	return slots == NULL ? 0 : (int)(mask + 1);
+}
+
+/**
+ * FUNCTION NAME: getDropped
+ *
+ * DESCRIPTION: Pushes refused because the ring was full
+ */
+long InboxRing::getDropped() {
+	return dropped.load(memory_order_relaxed);
+}
+
 /**
  * Copy constructor
  */
@@ -37,23 +227,57 @@ bool Address::operator ==(const Address& anotherAddress) {
 	return !memcmp(this->addr, anotherAddress.addr, sizeof(this->addr));
 }
 
+vector<NodeId> PeerDirectory::ids;
+unordered_map<NodeId, int> PeerDirectory::index;
+
+/**
+ * FUNCTION NAME: intern
+ *
+ * DESCRIPTION: Dense index of a NodeId, assigned the first time it is seen
+ */
+int PeerDirectory::intern(NodeId node) {
+	unordered_map<NodeId, int>::iterator known = index.find(node);
+	if ( known != index.end() ) {
+		return known->second;
+	}
+	ids.push_back(node);
+	index[node] = ids.size() - 1;
+	return ids.size() - 1;
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Bytes held by the directory, shared by every node of the process
+ */
+long PeerDirectory::memoryUsage() {
+	// hash nodes carry a next pointer and the cached hash, plus one bucket pointer each
+	return ids.capacity() * sizeof(NodeId)
+		+ index.size() * (sizeof(NodeId) + sizeof(int) + 2 * sizeof(void *))
+		+ index.bucket_count() * sizeof(void *);
+}
+
 /**
  * Constructor
  */
-MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp) {}
+MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): peer(PeerDirectory::intern(NodeId(id, port))), heartbeat(heartbeat), timestamp(timestamp) {}
+
+/**
+ * Constructor
+ */
+MemberListEntry::MemberListEntry(NodeId node, long heartbeat, long timestamp): peer(PeerDirectory::intern(node)), heartbeat(heartbeat), timestamp(timestamp) {}
 
 /**
  * Constuctor
  */
-MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
+MemberListEntry::MemberListEntry(int id, short port): peer(PeerDirectory::intern(NodeId(id, port))), heartbeat(0), timestamp(0) {}
 
 /**
  * Copy constructor
  */
 MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 	this->heartbeat = anotherMLE.heartbeat;
-	this->id = anotherMLE.id;
-	this->port = anotherMLE.port;
+	this->peer = anotherMLE.peer;
 	this->timestamp = anotherMLE.timestamp;
 }
 
@@ -63,19 +287,27 @@ MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE) {
 	MemberListEntry temp(anotherMLE);
 	swap(heartbeat, temp.heartbeat);
-	swap(id, temp.id);
-	swap(port, temp.port);
+	swap(peer, temp.peer);
 	swap(timestamp, temp.timestamp);
 	return *this;
 }
 
+/**
+ * FUNCTION NAME: getnode
+ *
+ * DESCRIPTION: getter
+ */
+NodeId MemberListEntry::getnode() {
+	return PeerDirectory::lookup(peer);
+}
+
 /**
  * FUNCTION NAME: getid
  *
  * DESCRIPTION: getter
  */
 int MemberListEntry::getid() {
-	return id;
+	return getnode().getid();
 }
 
 /**
@@ -84,7 +316,7 @@ int MemberListEntry::getid() {
  * DESCRIPTION: getter
  */
 short MemberListEntry::getport() {
-	return port;
+	return getnode().getport();
 }
 
 /**
@@ -111,7 +343,7 @@ long MemberListEntry::gettimestamp() {
  * DESCRIPTION: setter
  */
 void MemberListEntry::setid(int id) {
-	this->id = id;
+	this->peer = PeerDirectory::intern(NodeId(id, getport()));
 }
 
 /**
@@ -120,7 +352,7 @@ void MemberListEntry::setid(int id) {
  * DESCRIPTION: setter
  */
 void MemberListEntry::setport(short port) {
-	this->port = port;
+	this->peer = PeerDirectory::intern(NodeId(getid(), port));
 }
 
 /**
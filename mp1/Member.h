@@ -21,6 +21,51 @@ public:
 	q_elt(void *elt, int size);
 };
 
+/**
+ * CLASS NAME: InboxSlot
+ *
+ * DESCRIPTION: Slot of an InboxRing. seq tells producers and the consumer
+ * 				whose turn it is to use the slot.
+ */
+class InboxSlot {
+public:
+	atomic<unsigned long> seq;
+	void *elt;
+	int size;
+};
+
+/**
+ * CLASS NAME: InboxRing
+ *
+ * DESCRIPTION: Bounded lock-free multi-producer single-consumer queue of
+ * 				messages. Any thread may push; only the owning node pops.
+ * 				Slots are preallocated, and a push into a full ring is
+ * 				refused and counted instead of allocating. A ring built
+ * 				with capacity 0 holds no slots and refuses every push
+ * 				until it is resized.
+ */
+class InboxRing {
+private:
+	InboxSlot *slots;
+	unsigned long mask;
+	atomic<unsigned long> enqueuePos;
+	atomic<unsigned long> dequeuePos;
+	atomic<long> dropped;
+	void allocate(int capacity);
+public:
+	InboxRing(int capacity = 0);
+	InboxRing(const InboxRing &anotherRing);
+	InboxRing& operator =(const InboxRing &anotherRing);
+	virtual ~InboxRing();
+	void resize(int capacity);
+	bool push(void *elt, int size);
+	bool pop(q_elt &element);
+	bool empty();
+	int size();
+	int capacity();
+	long getDropped();
+};
+
 /**
  * CLASS NAME: Address
  *
@@ -54,22 +99,105 @@ public:
 	}
 };
 
+/**
+ * CLASS NAME: NodeId
+ *
+ * DESCRIPTION: A node's id and port packed into one 64-bit word. Trivially
+ * 				copyable, compared and hashed as an integer. Address is
+ * 				only built from it where a message or log line needs one.
+ */
+class NodeId {
+public:
+	uint64_t packed;
+	NodeId(): packed(0) {}
+	NodeId(int id, short port): packed(((uint64_t)(uint32_t)id << 16) | (uint16_t)port) {}
+	explicit NodeId(const Address &address) {
+		int id;
+		short port;
+		memcpy(&id, &address.addr[0], sizeof(int));
+		memcpy(&port, &address.addr[4], sizeof(short));
+		packed = ((uint64_t)(uint32_t)id << 16) | (uint16_t)port;
+	}
+	int getid() const {
+		return (int)(uint32_t)(packed >> 16);
+	}
+	short getport() const {
+		return (short)(uint16_t)packed;
+	}
+	// Write the 6-byte wire form, the same layout as Address::addr
+	void copyTo(char *addr) const {
+		int id = getid();
+		short port = getport();
+		memcpy(&addr[0], &id, sizeof(int));
+		memcpy(&addr[4], &port, sizeof(short));
+	}
+	Address toAddress() const {
+		Address address;
+		copyTo(address.addr);
+		return address;
+	}
+	string getAddress() const {
+		return to_string(getid()) + ":" + to_string(getport());
+	}
+	bool operator ==(const NodeId &anotherId) const {
+		return packed == anotherId.packed;
+	}
+	bool operator !=(const NodeId &anotherId) const {
+		return packed != anotherId.packed;
+	}
+	bool operator <(const NodeId &anotherId) const {
+		return packed < anotherId.packed;
+	}
+};
+
+namespace std {
+template <> struct hash<NodeId> {
+	size_t operator()(const NodeId &node) const {
+		// ids are dense, so spread them before bucketing
+		return (size_t)(node.packed * 0x9e3779b97f4a7c15ULL);
+	}
+};
+}
+
+/**
+ * CLASS NAME: PeerDirectory
+ *
+ * DESCRIPTION: Process-wide interned NodeIds. Membership lists refer to
+ * 				members by their dense index here, so an id is stored once
+ * 				per process instead of once per node that knows it. Indexes
+ * 				never leave the process; each shard has its own directory.
+ */
+class PeerDirectory {
+private:
+	static vector<NodeId> ids;
+	static unordered_map<NodeId, int> index;
+public:
+	static int intern(NodeId node);
+	static NodeId lookup(int peer) {
+		return ids[peer];
+	}
+	static long memoryUsage();
+};
+
 /**
  * CLASS NAME: MemberListEntry
  *
- * DESCRIPTION: Entry in the membership list
+ * DESCRIPTION: Entry in the membership list, 8 bytes
  */
 class MemberListEntry {
 public:
-	int id;
-	short port;
-	long heartbeat;
-	long timestamp;
+	// index of the member in the PeerDirectory
+	int peer;
+	// runs stay below USHRT_MAX ticks, so 16 bits hold any heartbeat or timestamp
+	unsigned short heartbeat;
+	unsigned short timestamp;
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
+	MemberListEntry(NodeId node, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
-	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
+	MemberListEntry(): peer(PeerDirectory::intern(NodeId())), heartbeat(0), timestamp(0) {}
 	MemberListEntry(const MemberListEntry &anotherMLE);
 	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
+	NodeId getnode();
 	int getid();
 	short getport();
 	long getheartbeat();
@@ -108,8 +236,8 @@ public:
 	vector<MemberListEntry> memberList;
 	// My position in the membership table
 	vector<MemberListEntry>::iterator myPos;
-	// Queue for failure detection messages
-	queue<q_elt> mp1q;
+	// Queue for failure detection messages, without slots until the node starts
+	InboxRing mp1q;
 	/**
 	 * Constructor
 	 */
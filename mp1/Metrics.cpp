@@ -0,0 +1,268 @@
+/**********************************
+ * FILE NAME: Metrics.cpp
+ *
+ * DESCRIPTION: Convergence and failure detection metrics of a run
+ **********************************/
+
+#include "Metrics.h"
+
+/**
+ * Constructor
+ */
+Metrics::Metrics(Params *par, int nodes): par(par), nodes(nodes), watched(nodes + 1, false), failedAt(nodes + 1, -1),
+	knows(nodes + 1), knownLive(nodes + 1, 0), holders(nodes + 1, 0),
+	firstDetection(nodes + 1, -1), lastDetection(nodes + 1, -1), convergenceTick(-1), falseRemovals(0), nodeTicks(0),
+	appMessages(0), appBytes(0), appLost(0), appRefused(0) {}
+
+/**
+ * FUNCTION NAME: isLive
+ *
+ * DESCRIPTION: Ground truth: the node has not been failed by Application
+ */
+bool Metrics::isLive(int id) {
+	return failedAt[id] < 0;
+}
+
+/**
+ * FUNCTION NAME: isStarted
+ *
+ * DESCRIPTION: Ground truth: Application has introduced the node
+ */
+bool Metrics::isStarted(int id) {
+	return par->getcurrtime() >= (int)(par->STEP_RATE * (id - 1));
+}
+
+/**
+ * FUNCTION NAME: sameScope
+ *
+ * DESCRIPTION: Check if a node is expected to know the other one
+ */
+bool Metrics::sameScope(int id, int anotherId) {
+	if ( par->ZONE_SIZE <= 0 ) {
+		return true;
+	}
+	return (id - 1) / par->ZONE_SIZE == (anotherId - 1) / par->ZONE_SIZE;
+}
+
+/**
+ * FUNCTION NAME: watch
+ *
+ * DESCRIPTION: Count a node as an observer, its events must reach this listener.
+ * 				Only observers get a row of knows, so a shard keeps rows for
+ * 				its own nodes.
+ */
+void Metrics::watch(int id) {
+	watched[id] = true;
+	knows[id].assign(nodes + 1, false);
+}
+
+/**
+ * FUNCTION NAME: detected
+ *
+ * DESCRIPTION: One more live observer has dropped a failed node
+ */
+void Metrics::detected(int id) {
+	int delay = par->getcurrtime() - failedAt[id];
+	if ( firstDetection[id] < 0 ) {
+		firstDetection[id] = delay;
+	}
+	if ( --holders[id] == 0 ) {
+		lastDetection[id] = delay;
+	}
+}
+
+/**
+ * FUNCTION NAME: membershipChanged
+ *
+ * DESCRIPTION: Track what each observer knows
+ */
+void Metrics::membershipChanged(Address *self, const vector<MembershipEvent> &events) {
+	int observer = NodeId(*self).getid();
+	for ( auto &event : events ) {
+		int id = NodeId(event.addr).getid();
+		if ( id < 1 || id > nodes || id == observer ) {
+			continue;
+		}
+		if ( event.type == MEMBER_JOINED && !knows[observer][id] ) {
+			knows[observer][id] = true;
+			if ( isLive(id) ) {
+				if ( sameScope(observer, id) ) {
+					knownLive[observer]++;
+				}
+			}
+			else {
+				// stale gossip brought a failed node back
+				holders[id]++;
+			}
+		}
+		else if ( event.type == MEMBER_REMOVED && knows[observer][id] ) {
+			knows[observer][id] = false;
+			if ( isLive(id) ) {
+				// foreign zone representatives are evicted by design
+				if ( sameScope(observer, id) ) {
+					knownLive[observer]--;
+					falseRemovals++;
+				}
+			}
+			else {
+				detected(id);
+			}
+		}
+		// a partial view drops live members by design, and a dead one is dropped all the same
+		else if ( event.type == MEMBER_DEMOTED && knows[observer][id] ) {
+			knows[observer][id] = false;
+			if ( !isLive(id) ) {
+				detected(id);
+			}
+			else if ( sameScope(observer, id) ) {
+				knownLive[observer]--;
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: nodeFailed
+ *
+ * DESCRIPTION: Record a failure injected by Application. A node that has not
+ * 				been introduced yet is not failed: starting it clears bFailed
+ * 				and it runs like any other node.
+ */
+void Metrics::nodeFailed(int id) {
+	if ( !isStarted(id) ) {
+		return;
+	}
+	failedAt[id] = par->getcurrtime();
+
+	// everybody who lists the node now has to detect it
+	for ( int observer = 1; observer <= nodes; observer++ ) {
+		if ( !watched[observer] || !isLive(observer) || !knows[observer][id] ) {
+			continue;
+		}
+		if ( sameScope(observer, id) ) {
+			knownLive[observer]--;
+		}
+		holders[id]++;
+	}
+
+	// and the node no longer has to detect anybody
+	if ( !watched[id] ) {
+		return;
+	}
+	for ( int other = 1; other <= nodes; other++ ) {
+		if ( other != id && !isLive(other) && knows[id][other] ) {
+			if ( --holders[other] == 0 && firstDetection[other] >= 0 ) {
+				lastDetection[other] = par->getcurrtime() - failedAt[other];
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: tick
+ *
+ * DESCRIPTION: Called at the end of every tick. Counts running nodes and
+ * 				checks if every live node knows every live node of its zone.
+ */
+void Metrics::tick() {
+	int zones = par->ZONE_SIZE > 0 ? (nodes - 1) / par->ZONE_SIZE + 1 : 1;
+	vector<int> liveStarted(zones, 0);
+	for ( int id = 1; id <= nodes; id++ ) {
+		if ( isLive(id) && isStarted(id) ) {
+			liveStarted[par->ZONE_SIZE > 0 ? (id - 1) / par->ZONE_SIZE : 0]++;
+			if ( watched[id] ) {
+				nodeTicks++;
+			}
+		}
+	}
+
+	if ( convergenceTick >= 0 || !isStarted(nodes) ) {
+		return;
+	}
+	for ( int id = 1; id <= nodes; id++ ) {
+		if ( !watched[id] || !isLive(id) ) {
+			continue;
+		}
+		int zone = par->ZONE_SIZE > 0 ? (id - 1) / par->ZONE_SIZE : 0;
+		// a partial view is complete once at least half of its slots are taken
+		if ( par->VIEW_SIZE > 0 ) {
+			if ( knownLive[id] < min(liveStarted[zone] - 1, max(1, par->VIEW_SIZE / 2)) ) {
+				return;
+			}
+		}
+		else if ( knownLive[id] != liveStarted[zone] - 1 ) {
+			return;
+		}
+	}
+	convergenceTick = par->getcurrtime();
+}
+
+/**
+ * FUNCTION NAME: appTraffic
+ *
+ * DESCRIPTION: Record the application traffic that shared the network
+ */
+void Metrics::appTraffic(long messages, long bytes, long lost, long refused) {
+	appMessages = messages;
+	appBytes = bytes;
+	appLost = lost;
+	appRefused = refused;
+}
+
+/**
+ * FUNCTION NAME: writeReport
+ *
+ * DESCRIPTION: Write the run's metrics as JSON. Detection delays are in ticks
+ * 				after the failure, null when no live observer got there.
+ * 				messages and bytes count protocol traffic only.
+ */
+void Metrics::writeReport(const char *filename, long messages, long bytes) {
+	FILE *fp = fopen(filename, "w");
+	if ( fp == NULL ) {
+		return;
+	}
+	double perNodeTick = nodeTicks > 0 ? 1.0 / nodeTicks : 0;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"nodes\": %d,\n", nodes);
+	fprintf(fp, "  \"ticks\": %d,\n", par->getcurrtime());
+	if ( convergenceTick >= 0 ) {
+		fprintf(fp, "  \"convergence_tick\": %d,\n", convergenceTick);
+	}
+	else {
+		fprintf(fp, "  \"convergence_tick\": null,\n");
+	}
+	fprintf(fp, "  \"false_removals\": %ld,\n", falseRemovals);
+	fprintf(fp, "  \"messages_total\": %ld,\n", messages);
+	fprintf(fp, "  \"bytes_total\": %ld,\n", bytes);
+	fprintf(fp, "  \"messages_per_node_per_tick\": %.3f,\n", messages * perNodeTick);
+	fprintf(fp, "  \"bytes_per_node_per_tick\": %.1f,\n", bytes * perNodeTick);
+	fprintf(fp, "  \"app_messages\": %ld,\n", appMessages);
+	fprintf(fp, "  \"app_bytes\": %ld,\n", appBytes);
+	fprintf(fp, "  \"app_lost\": %ld,\n", appLost);
+	fprintf(fp, "  \"app_refused\": %ld,\n", appRefused);
+	fprintf(fp, "  \"failures\": [");
+	bool first = true;
+	for ( int id = 1; id <= nodes; id++ ) {
+		if ( isLive(id) ) {
+			continue;
+		}
+		fprintf(fp, "%s\n    {\"node\": \"%s\", \"failed_at\": %d, ", first ? "" : ",", NodeId(id, 0).getAddress().c_str(), failedAt[id]);
+		if ( firstDetection[id] >= 0 ) {
+			fprintf(fp, "\"first_detection\": %d, ", firstDetection[id]);
+		}
+		else {
+			fprintf(fp, "\"first_detection\": null, ");
+		}
+		if ( lastDetection[id] >= 0 && holders[id] == 0 ) {
+			fprintf(fp, "\"last_detection\": %d, ", lastDetection[id]);
+		}
+		else {
+			fprintf(fp, "\"last_detection\": null, ");
+		}
+		fprintf(fp, "\"still_listed_by\": %d}", holders[id]);
+		first = false;
+	}
+	fprintf(fp, "%s]\n}\n", first ? "" : "\n  ");
+	fclose(fp);
+}
@@ -0,0 +1,65 @@
+/**********************************
+ * FILE NAME: Metrics.h
+ *
+ * DESCRIPTION: Convergence and failure detection metrics of a run,
+ * 				measured against the ground truth kept by Application
+ **********************************/
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "MP1Node.h"
+
+/**
+ * CLASS NAME: Metrics
+ *
+ * DESCRIPTION: Listens to the membership changes of every watched node and
+ * 				compares them with who is really alive. A node is expected
+ * 				to know every live started node of its zone (the whole
+ * 				group for flat gossip), or to fill half of its active view
+ * 				with partial views.
+ */
+class Metrics: public MembershipListener {
+private:
+	Params *par;
+	int nodes;
+	// observers whose events reach this process
+	vector<bool> watched;
+	// tick each node failed at, -1 while alive
+	vector<int> failedAt;
+	// knows[observer][member], empty rows for nodes that are not watched
+	vector<vector<bool> > knows;
+	// live members of its zone each observer knows
+	vector<int> knownLive;
+	// watched live observers still listing a failed node
+	vector<int> holders;
+	vector<int> firstDetection;
+	vector<int> lastDetection;
+	int convergenceTick;
+	long falseRemovals;
+	// ticks during which nodes were running, summed over nodes
+	long nodeTicks;
+	// application traffic sharing the network
+	long appMessages;
+	long appBytes;
+	long appLost;
+	long appRefused;
+	bool isLive(int id);
+	bool isStarted(int id);
+	bool sameScope(int id, int anotherId);
+	void detected(int id);
+public:
+	Metrics(Params *par, int nodes);
+	virtual ~Metrics() {}
+	void watch(int id);
+	void membershipChanged(Address *self, const vector<MembershipEvent> &events);
+	void nodeFailed(int id);
+	void tick();
+	void appTraffic(long messages, long bytes, long lost, long refused);
+	void writeReport(const char *filename, long messages, long bytes);
+};
+
+#endif /* _METRICS_H_ */
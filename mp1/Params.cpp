@@ -26,8 +26,56 @@ void Params::setparams(char *config_file) {
 
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
-	EN_GPSZ = MAX_NNB;
+	ZONE_SIZE = 0;
+	ZONE_REPS = 2;
+	VIEW_SIZE = 0;
+	PASSIVE_VIEW_SIZE = 30;
+	SHUFFLE_PERIOD = 5;
+	SHUFFLE_LENGTH = 4;
+	LEAVE_FANOUT = 4;
+	GRACEFUL_LEAVE = 0;
+	JOIN_VIEW_SIZE = 32;
+	DIGEST_RANGES = 0;
+	DIGEST_BUCKET = 4;
+	NET_ZONE_SIZE = 0;
+	NET_LATENCY_LOCAL = 0;
+	NET_LATENCY_REMOTE = 0;
+	NET_JITTER = 0;
+	NET_BANDWIDTH = 0;
+	PARTITIONS.clear();
+	PHI_THRESHOLD = 0;
+	MEM_REPORT_INTERVAL = 0;
+	NODE_MEM_BUDGET = 0;
+	EN_MEM_BUDGET = 0;
+	EN_SEND_QUOTA = 0;
+	EN_QUEUE_LIMIT = 0;
+	EN_PRIORITY_LANES = 0;
+	EN_CONTROL_SLOTS = 1000;
+	EN_CONTROL_DROP_PROB = 0;
+	JOIN_RETRY = 0;
+	EN_TRACE = 0;
+	INBOX_SIZE = RING_SIZE;
+	CORO_RUNTIME = 0;
+	DISSEMINATION_MULT = 0;
+	DISSEMINATION_BYTES = 512;
+	INCREMENTAL_SWEEP = 0;
+	APP_RATE = 0;
+	APP_SIZE = 100;
+	APP_SKEW = 0;
+	METRICS = 1;
+	SHARDS = 1;
+	SHARD_RING_BYTES = 1 << 22;
+	TICK_MS = 100;
 	STEP_RATE=.25;
+
+	// Optional "KEY: value" lines may follow the mandatory ones
+	char key[64];
+	double value;
+	while ( fscanf(fp, " %63[^:]: %lf", key, &value) == 2 ) {
+		setparam(key, value);
+	}
+
+	EN_GPSZ = MAX_NNB;
 	MAX_MSG_SIZE = 4000;
 	globaltime = 0;
 	dropmsg = 0;
@@ -39,6 +87,149 @@ void Params::setparams(char *config_file) {
 	return;
 }
 
+/**
+ * FUNCTION NAME: setparam
+ *
+ * DESCRIPTION: Set a single optional parameter read from the test case.
+ * 				Unknown keys are ignored.
+ */
+void Params::setparam(const char *key, double value) {
+	if ( strcmp(key, "ZONE_SIZE") == 0 ) {
+		ZONE_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "ZONE_REPS") == 0 ) {
+		ZONE_REPS = (int) value;
+	}
+	else if ( strcmp(key, "VIEW_SIZE") == 0 ) {
+		VIEW_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "PASSIVE_VIEW_SIZE") == 0 ) {
+		PASSIVE_VIEW_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "SHUFFLE_PERIOD") == 0 ) {
+		SHUFFLE_PERIOD = (int) value;
+	}
+	else if ( strcmp(key, "SHUFFLE_LENGTH") == 0 ) {
+		SHUFFLE_LENGTH = (int) value;
+	}
+	else if ( strcmp(key, "LEAVE_FANOUT") == 0 ) {
+		LEAVE_FANOUT = (int) value;
+	}
+	else if ( strcmp(key, "GRACEFUL_LEAVE") == 0 ) {
+		GRACEFUL_LEAVE = (int) value;
+	}
+	else if ( strcmp(key, "JOIN_VIEW_SIZE") == 0 ) {
+		JOIN_VIEW_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "STEP_RATE") == 0 ) {
+		STEP_RATE = value;
+	}
+	else if ( strcmp(key, "DIGEST_RANGES") == 0 ) {
+		DIGEST_RANGES = (int) value;
+	}
+	else if ( strcmp(key, "DIGEST_BUCKET") == 0 ) {
+		DIGEST_BUCKET = (int) value;
+	}
+	else if ( strcmp(key, "NET_ZONE_SIZE") == 0 ) {
+		NET_ZONE_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "NET_LATENCY_LOCAL") == 0 ) {
+		NET_LATENCY_LOCAL = (int) value;
+	}
+	else if ( strcmp(key, "NET_LATENCY_REMOTE") == 0 ) {
+		NET_LATENCY_REMOTE = (int) value;
+	}
+	else if ( strcmp(key, "NET_JITTER") == 0 ) {
+		NET_JITTER = (int) value;
+	}
+	else if ( strcmp(key, "NET_BANDWIDTH") == 0 ) {
+		NET_BANDWIDTH = (int) value;
+	}
+	else if ( strcmp(key, "PHI_THRESHOLD") == 0 ) {
+		PHI_THRESHOLD = value;
+	}
+	else if ( strcmp(key, "MEM_REPORT_INTERVAL") == 0 ) {
+		MEM_REPORT_INTERVAL = (int) value;
+	}
+	else if ( strcmp(key, "NODE_MEM_BUDGET") == 0 ) {
+		NODE_MEM_BUDGET = (long) value;
+	}
+	else if ( strcmp(key, "EN_MEM_BUDGET") == 0 ) {
+		EN_MEM_BUDGET = (long) value;
+	}
+	else if ( strcmp(key, "EN_SEND_QUOTA") == 0 ) {
+		EN_SEND_QUOTA = (int) value;
+	}
+	else if ( strcmp(key, "EN_QUEUE_LIMIT") == 0 ) {
+		EN_QUEUE_LIMIT = (int) value;
+	}
+	else if ( strcmp(key, "EN_PRIORITY_LANES") == 0 ) {
+		EN_PRIORITY_LANES = (int) value;
+	}
+	else if ( strcmp(key, "EN_CONTROL_SLOTS") == 0 ) {
+		EN_CONTROL_SLOTS = (int) value;
+	}
+	else if ( strcmp(key, "EN_CONTROL_DROP_PROB") == 0 ) {
+		EN_CONTROL_DROP_PROB = value;
+	}
+	else if ( strcmp(key, "JOIN_RETRY") == 0 ) {
+		JOIN_RETRY = (int) value;
+	}
+	else if ( strcmp(key, "EN_TRACE") == 0 ) {
+		EN_TRACE = (int) value;
+	}
+	else if ( strcmp(key, "INBOX_SIZE") == 0 ) {
+		INBOX_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "CORO_RUNTIME") == 0 ) {
+		CORO_RUNTIME = (int) value;
+	}
+	else if ( strcmp(key, "DISSEMINATION_MULT") == 0 ) {
+		DISSEMINATION_MULT = value;
+	}
+	else if ( strcmp(key, "DISSEMINATION_BYTES") == 0 ) {
+		DISSEMINATION_BYTES = (int) value;
+	}
+	else if ( strcmp(key, "INCREMENTAL_SWEEP") == 0 ) {
+		INCREMENTAL_SWEEP = (int) value;
+	}
+	else if ( strcmp(key, "APP_RATE") == 0 ) {
+		APP_RATE = value;
+	}
+	else if ( strcmp(key, "APP_SIZE") == 0 ) {
+		APP_SIZE = (int) value;
+	}
+	else if ( strcmp(key, "APP_SKEW") == 0 ) {
+		APP_SKEW = value;
+	}
+	else if ( strcmp(key, "METRICS") == 0 ) {
+		METRICS = (int) value;
+	}
+	else if ( strcmp(key, "SHARDS") == 0 ) {
+		SHARDS = (int) value;
+	}
+	else if ( strcmp(key, "SHARD_RING_BYTES") == 0 ) {
+		SHARD_RING_BYTES = (long) value;
+	}
+	else if ( strcmp(key, "TICK_MS") == 0 ) {
+		TICK_MS = (int) value;
+	}
+	// PARTITION_ZONE starts a new partition, START and END apply to the latest one
+	else if ( strcmp(key, "PARTITION_ZONE") == 0 ) {
+		NetPartition partition;
+		partition.zone = (int) value;
+		partition.start = 0;
+		partition.end = 0;
+		PARTITIONS.push_back(partition);
+	}
+	else if ( strcmp(key, "PARTITION_START") == 0 && !PARTITIONS.empty() ) {
+		PARTITIONS.back().start = (int) value;
+	}
+	else if ( strcmp(key, "PARTITION_END") == 0 && !PARTITIONS.empty() ) {
+		PARTITIONS.back().end = (int) value;
+	}
+}
+
 /**
  * FUNCTION NAME: getcurrtime
  *
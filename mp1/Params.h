@@ -13,6 +13,17 @@
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
 
+/**
+ * STRUCT NAME: NetPartition
+ *
+ * DESCRIPTION: Network zone cut off from all other zones during [start, end)
+ */
+typedef struct NetPartition {
+	int zone;
+	int start;
+	int end;
+}NetPartition;
+
 /**
  * CLASS NAME: Params
  *
@@ -31,8 +42,49 @@ public:
 	int globaltime;
 	int allNodesJoined;
 	short PORTNUM;
+	int ZONE_SIZE;				// members per gossip zone, 0 for flat gossip
+	int ZONE_REPS;				// representatives kept per foreign zone
+	int VIEW_SIZE;				// active view of a partial view node, about log2(N) + 1; 0 to list every member
+	int PASSIVE_VIEW_SIZE;		// peers a partial view node knows of besides its active view
+	int SHUFFLE_PERIOD;			// ticks between two passive view shuffles
+	int SHUFFLE_LENGTH;			// entries exchanged by a shuffle
+	int LEAVE_FANOUT;			// members a LEAVE is sent to, by the leaver and by each relay
+	int GRACEFUL_LEAVE;			// 1 to make failing nodes leave cleanly instead of crashing
+	int JOIN_VIEW_SIZE;			// max members in a JOINREP
+	int DIGEST_RANGES;			// ranges per gossip digest, 0 to gossip full lists
+	int DIGEST_BUCKET;			// heartbeats per digest bucket
+	int NET_ZONE_SIZE;			// nodes per network zone, 0 for a single zone
+	int NET_LATENCY_LOCAL;		// extra delivery delay inside a network zone, in ticks
+	int NET_LATENCY_REMOTE;		// extra delivery delay across network zones, in ticks
+	int NET_JITTER;				// max uniform extra delay, in ticks
+	int NET_BANDWIDTH;			// outbound bytes per node per tick, 0 for unlimited
+	vector<NetPartition> PARTITIONS;	// scheduled partitions
+	double PHI_THRESHOLD;		// phi-accrual removal threshold, 0 for TFAIL/TREMOVE
+	int MEM_REPORT_INTERVAL;	// ticks between memory reports, 0 to report only at the end
+	long NODE_MEM_BUDGET;		// bytes per node before queued messages are shed, 0 for none
+	long EN_MEM_BUDGET;			// bytes of buffered messages in EmulNet, 0 for none
+	int EN_SEND_QUOTA;			// messages a node may send per tick, 0 for unlimited
+	int EN_QUEUE_LIMIT;			// messages EmulNet holds for one node, 0 for unlimited
+	int EN_PRIORITY_LANES;		// 1 to give joins, leaves and view changes their own EmulNet lane
+	int EN_CONTROL_SLOTS;		// messages the control lane holds
+	double EN_CONTROL_DROP_PROB;	// drop probability of control messages while messages are dropped
+	int JOIN_RETRY;				// ticks a joining node waits for a JOINREP before asking again, 0 to ask once
+	int EN_TRACE;				// 1 to record EmulNet traffic to entrace.bin, 2 to replay it
+	int INBOX_SIZE;				// messages a node can hold between two ticks
+	int CORO_RUNTIME;			// 1 to run node protocols as coroutines (make coro)
+	double DISSEMINATION_MULT;	// probe gossip targets and piggyback news on DISSEMINATION_MULT * log10(N + 1) probes, 0 to gossip full lists
+	int DISSEMINATION_BYTES;	// max bytes of a DISSEMINATE message
+	double APP_RATE;			// application messages each running node sends per tick, 0 for none
+	int APP_SIZE;				// bytes of an application message
+	double APP_SKEW;			// Zipf exponent of application destinations, 0 for uniform
+	int INCREMENTAL_SWEEP;		// 1 to check a rotating slice of the member list per tick instead of all of it
+	int METRICS;				// 1 (default) to track what every node knows and write metrics.json at the end, 0 to skip it
+	int SHARDS;					// simulation processes the node range is split across
+	long SHARD_RING_BYTES;		// bytes per shared-memory ring between two shards
+	int TICK_MS;				// wall clock length of a tick when a node runs standalone (Daemon)
 	Params();
 	void setparams(char *);
+	void setparam(const char *key, double value);
 	int getcurrtime();
 };
 
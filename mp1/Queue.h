@@ -24,6 +24,9 @@ public:
 		queue->emplace(element);
 		return true;
 	}
+	static bool enqueue(InboxRing *inbox, void *buffer, int size) {
+		return inbox->push(buffer, size);
+	}
 };
 
 #endif /* QUEUE_H_ */
@@ -0,0 +1,162 @@
+/**********************************
+ * FILE NAME: ShmTransport.cpp
+ *
+ * DESCRIPTION: Shared-memory transport between simulation shard processes
+ **********************************/
+
+#include "ShmTransport.h"
+#include <sched.h>
+#include <sys/mman.h>
+
+/**
+ * Constructor
+ *
+ * The ring size is rounded up to a power of two so offsets can be masked
+ */
+ShmTransport::ShmTransport(int shards, long ringBytes) {
+	this->shards = shards;
+	this->ringBytes = 4096;
+	while ( (long) this->ringBytes < ringBytes ) {
+		this->ringBytes <<= 1;
+	}
+	mapSize = SHM_CACHE_LINE + (size_t) shards * shards * (sizeof(ShmRing) + this->ringBytes);
+
+	int fd = memfd_create("mp1-shards", 0);
+	if ( fd < 0 || ftruncate(fd, mapSize) != 0 ) {
+		perror("memfd_create");
+		exit(1);
+	}
+	base = (char *) mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if ( base == MAP_FAILED ) {
+		perror("mmap");
+		exit(1);
+	}
+
+	sync = new (base) ShmBarrier();
+	for ( int from = 0; from < shards; from++ ) {
+		for ( int to = 0; to < shards; to++ ) {
+			new (ring(from, to)) ShmRing();
+		}
+	}
+}
+
+/**
+ * Destructor
+ */
+ShmTransport::~ShmTransport() {
+	munmap(base, mapSize);
+}
+
+/**
+ * FUNCTION NAME: ring
+ *
+ * DESCRIPTION: Ring carrying messages from shard from to shard to
+ */
+ShmRing *ShmTransport::ring(int from, int to) {
+	return (ShmRing *)(base + SHM_CACHE_LINE + (size_t)(from * shards + to) * (sizeof(ShmRing) + ringBytes));
+}
+
+/**
+ * FUNCTION NAME: ringData
+ *
+ * DESCRIPTION: First data byte of a ring
+ */
+char *ShmTransport::ringData(ShmRing *r) {
+	return (char *)(r + 1);
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: Append a size-prefixed record to a ring. Like a full EmulNet
+ * 				buffer, a full ring drops the message rather than wait
+ * 				for a consumer that may itself be waiting at the barrier.
+ *
+ * RETURNS:
+ * true if the message was queued
+ */
+bool ShmTransport::push(int from, int to, const char *data, int size) {
+	ShmRing *r = ring(from, to);
+	char *ringbuf = ringData(r);
+	unsigned long record = (sizeof(int) + size + 7) & ~7UL;
+	unsigned long head = r->head.load(memory_order_relaxed);
+	unsigned long tail = r->tail.load(memory_order_acquire);
+
+	if ( head - tail + record > ringBytes ) {
+		sync->dropped.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	// Records are 8-byte aligned so the length prefix never wraps
+	*(int *)(ringbuf + (head & (ringBytes - 1))) = size;
+	unsigned long offset = (head + sizeof(int)) & (ringBytes - 1);
+	unsigned long first = min((unsigned long) size, ringBytes - offset);
+	memcpy(ringbuf + offset, data, first);
+	memcpy(ringbuf, data + first, size - first);
+
+	r->head.store(head + record, memory_order_release);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Hand every record queued for shard to to the deliver callback
+ *
+ * RETURNS:
+ * number of records delivered
+ */
+int ShmTransport::drain(int to, int (* deliver)(void *, char *, int), void *env) {
+	int count = 0;
+	for ( int from = 0; from < shards; from++ ) {
+		if ( from == to ) {
+			continue;
+		}
+		ShmRing *r = ring(from, to);
+		char *ringbuf = ringData(r);
+		unsigned long tail = r->tail.load(memory_order_relaxed);
+		unsigned long head = r->head.load(memory_order_acquire);
+
+		while ( tail != head ) {
+			int size = *(int *)(ringbuf + (tail & (ringBytes - 1)));
+			char *data = (char *) malloc(size);
+			unsigned long offset = (tail + sizeof(int)) & (ringBytes - 1);
+			unsigned long first = min((unsigned long) size, ringBytes - offset);
+			memcpy(data, ringbuf + offset, first);
+			memcpy(data + first, ringbuf, size - first);
+
+			(*deliver)(env, data, size);
+			tail += (sizeof(int) + size + 7) & ~7UL;
+			count++;
+		}
+		r->tail.store(tail, memory_order_release);
+	}
+	return count;
+}
+
+/**
+ * FUNCTION NAME: barrier
+ *
+ * DESCRIPTION: Wait until every shard has finished the current tick
+ */
+void ShmTransport::barrier() {
+	int generation = sync->generation.load(memory_order_acquire);
+	if ( sync->arrived.fetch_add(1, memory_order_acq_rel) == shards - 1 ) {
+		sync->arrived.store(0, memory_order_relaxed);
+		sync->generation.fetch_add(1, memory_order_release);
+		return;
+	}
+	while ( sync->generation.load(memory_order_acquire) == generation ) {
+		sched_yield();
+	}
+}
+
+/**
+ * FUNCTION NAME: getDropped
+ *
+ * DESCRIPTION: Messages dropped on full rings, summed over all shards
+ */
+long ShmTransport::getDropped() {
+	return sync->dropped.load(memory_order_relaxed);
+}
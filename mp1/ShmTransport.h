@@ -0,0 +1,64 @@
+/**********************************
+ * FILE NAME: ShmTransport.h
+ *
+ * DESCRIPTION: Shared-memory transport between simulation shard processes
+ **********************************/
+
+#ifndef _SHMTRANSPORT_H_
+#define _SHMTRANSPORT_H_
+
+#include "stdincludes.h"
+
+#define SHM_CACHE_LINE 64
+
+/**
+ * STRUCT NAME: ShmRing
+ *
+ * DESCRIPTION: Single-producer single-consumer byte ring. The ring data
+ * 				follows the header in the shared mapping.
+ */
+typedef struct ShmRing {
+	// Bytes ever written, advanced by the producing shard only
+	atomic<unsigned long> head;
+	char headPad[SHM_CACHE_LINE - sizeof(atomic<unsigned long>)];
+	// Bytes ever consumed, advanced by the consuming shard only
+	atomic<unsigned long> tail;
+	char tailPad[SHM_CACHE_LINE - sizeof(atomic<unsigned long>)];
+}ShmRing;
+
+/**
+ * STRUCT NAME: ShmBarrier
+ *
+ * DESCRIPTION: Sense-reversing tick barrier shared by all shards
+ */
+typedef struct ShmBarrier {
+	atomic<int> arrived;
+	atomic<int> generation;
+	atomic<long> dropped;
+}ShmBarrier;
+
+/**
+ * CLASS NAME: ShmTransport
+ *
+ * DESCRIPTION: One ring per ordered pair of shards in a memfd mapping that
+ * 				is created before the shards are forked
+ */
+class ShmTransport {
+private:
+	int shards;
+	unsigned long ringBytes;
+	size_t mapSize;
+	char *base;
+	ShmBarrier *sync;
+	ShmRing *ring(int from, int to);
+	char *ringData(ShmRing *r);
+public:
+	ShmTransport(int shards, long ringBytes);
+	virtual ~ShmTransport();
+	bool push(int from, int to, const char *data, int size);
+	int drain(int to, int (* deliver)(void *, char *, int), void *env);
+	void barrier();
+	long getDropped();
+};
+
+#endif /* _SHMTRANSPORT_H_ */
@@ -18,6 +18,8 @@
  * Standard Header files
  */
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -31,10 +33,12 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <algorithm>
 #include <queue>
 #include <fstream>
+#include <atomic>
 
 using namespace std;
 